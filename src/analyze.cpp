@@ -0,0 +1,731 @@
+/*
+    clang-format off
+
+    isola_analyze: searches every position of a file, for puzzles or going
+    over played games.
+
+        isola_analyze (--positions <file> | --records <file>)
+                      [--cache <file>] [--threads <n>] [--hash <mb>]
+                      [--depth <n>] [--movetime <ms>] [--nodes <n>]
+                      [--tablebase <file>] [--size <rows>x<cols>]
+
+    --positions reads boards in the Board::toString() format, as its lines
+    or on one line with the rows separated by '/', each optionally followed
+    by the side to move, B or W. Without one, the side is worked out from
+    the number of dead squares, which grows by two every turn. Lines
+    starting with '#' are skipped. --size gives the board, 7x7 by default.
+    --records reads every position of every game of a record file (see
+    record.hpp) and takes the board from its header.
+
+    Positions that occur more than once are searched and printed once,
+    under the label of the first: the line number for --positions,
+    <game>.<turn> for --records. Each line gives the result
+
+        <label> <board> <B|W> score <s> depth <d> nodes <n> time <ms>
+            [cached] pv <move> ...
+
+    with the board written as the protocol's position board takes it. Lines
+    come in the order the positions are finished. Every search is limited by
+    --depth (default 8), or by --movetime or --nodes instead.
+
+    The positions are shared out in one contiguous block per --threads
+    (default: every core), each thread with its own single threaded engine
+    whose table carries over from one position to the next, the positions
+    of a game in order reuse what was learned on the ones before. A thread
+    that runs out steals the back half of the block with the most left, so
+    a few long searches don't leave the other threads idle.
+
+    --cache is a file of results keyed by the Zobrist hash of the position,
+    read at the start and appended to as positions are finished, so
+    running again over overlapping data skips whatever was done before. A
+    cached result is used when its score is proven, a win or a loss, or when
+    the run is limited by depth only and the cached one is at least as deep.
+
+        file      header: magic "ISAC", version, rows, cols
+                  results, appended in the order they were found:
+                      key, nodes, score, depth, moves of the line
+                      and the line, a step and arrow byte per move as in
+                      record.hpp
+
+    A later result for a position replaces an earlier one, and a trailing
+    partial result, left by a run that was cut off, is dropped. Like the
+    other file formats it is read in the byte order of the machine that
+    wrote it.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "board.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+#include "mapped_file.hpp"
+#include "notation.hpp"
+#include "record.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Moves of a line that are printed and cached
+constexpr int PV_MOVES = 20;
+constexpr std::uint8_t CACHE_VERSION = 1;
+
+struct Config {
+  isola::BoardSize size{isola::DefaultGeometry::ROWS,
+                        isola::DefaultGeometry::COLS};
+  const char *positions = nullptr;
+  const char *records = nullptr;
+  const char *cache = nullptr;
+  const char *tablebase = nullptr;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t hashMB = 16;
+  isola::SearchLimits limits{.maxDepth = 8};
+};
+
+struct CacheHeader {
+  char magic[4] = {'I', 'S', 'A', 'C'};
+  std::uint8_t version = CACHE_VERSION;
+  std::uint8_t rows = 0;
+  std::uint8_t cols = 0;
+  std::uint8_t reserved[9] = {};
+
+  template <class G> static CacheHeader forGeometry() {
+    CacheHeader header;
+    header.rows = G::ROWS;
+    header.cols = G::COLS;
+    return header;
+  }
+};
+
+static_assert(sizeof(CacheHeader) == 16, "results follow the header");
+
+struct CacheEntry {
+  std::uint64_t key = 0;
+  std::uint64_t nodes = 0;
+  std::int32_t score = 0;
+  std::uint8_t depth = 0;
+  std::uint8_t pvLength = 0;
+  std::uint8_t reserved[2] = {};
+  isola::RecordedTurn pv[PV_MOVES] = {};
+};
+
+static_assert(sizeof(CacheEntry) == 24 + 2 * PV_MOVES,
+              "results are written as raw bytes");
+
+struct Analysis {
+  isola::Score score = 0;
+  int depth = 0;
+  std::uint64_t nodes = 0;
+  std::chrono::microseconds elapsed{0};
+  std::vector<isola::Move> pv;
+  bool cached = false;
+};
+
+template <class G> struct Position {
+  isola::BasicGameState<G> state;
+  std::string label;
+};
+
+// The results of earlier runs, and the file the new ones go to
+template <class G> class AnalysisCache {
+  std::unordered_map<std::uint64_t, CacheEntry> m_entries;
+  std::FILE *m_file = nullptr;
+  bool m_ok = true;
+
+public:
+  AnalysisCache() = default;
+  AnalysisCache(const AnalysisCache &) = delete;
+  AnalysisCache &operator=(const AnalysisCache &) = delete;
+
+  ~AnalysisCache() { close(); }
+
+  // Reads the results at `path` and opens it for more, creating it when it
+  // doesn't exist. False when it can't or the file isn't a cache for G
+  bool open(const char *path) {
+    CacheHeader expected = CacheHeader::forGeometry<G>();
+    std::size_t size = 0;
+    if (std::optional<isola::MappedFile> file = isola::MappedFile::open(path)) {
+      if (file->size() < sizeof(CacheHeader) ||
+          std::memcmp(file->data(), &expected, sizeof(expected)) != 0) {
+        return false;
+      }
+      std::size_t count =
+          (file->size() - sizeof(CacheHeader)) / sizeof(CacheEntry);
+      for (std::size_t i = 0; i < count; ++i) {
+        CacheEntry entry;
+        std::memcpy(&entry,
+                    file->data() + sizeof(CacheHeader) +
+                        i * sizeof(CacheEntry),
+                    sizeof(entry));
+        // A damaged or foreign file, the line would run past the entry
+        if (entry.pvLength > PV_MOVES) {
+          continue;
+        }
+        m_entries[entry.key] = entry;
+      }
+      size = sizeof(CacheHeader) + count * sizeof(CacheEntry);
+    }
+
+    // New results must not land after half a result
+    std::error_code error;
+    if (size > 0 && std::filesystem::file_size(path, error) != size) {
+      std::filesystem::resize_file(path, size, error);
+      if (error) {
+        return false;
+      }
+    }
+    m_file = std::fopen(path, "ab");
+    if (m_file && size == 0) {
+      m_ok = std::fwrite(&expected, sizeof(expected), 1, m_file) == 1;
+    }
+    return m_file && m_ok;
+  }
+
+  std::size_t size() const { return m_entries.size(); }
+
+  // The cached result for `state`, when there is one that replays
+  std::optional<Analysis> find(const isola::BasicGameState<G> &state) const {
+    auto it = m_entries.find(state.hash());
+    if (it == m_entries.end()) {
+      return std::nullopt;
+    }
+    const CacheEntry &entry = it->second;
+    Analysis analysis{.score = entry.score,
+                      .depth = entry.depth,
+                      .nodes = entry.nodes,
+                      .cached = true};
+    isola::BasicGameState<G> line = state;
+    for (int i = 0; i < entry.pvLength; ++i) {
+      isola::Move move{
+          .from = static_cast<std::int8_t>(line.player(line.sideToMove())),
+          .to = static_cast<std::int8_t>(entry.pv[i].step),
+          .arrow = entry.pv[i].arrow == isola::NO_ARROW
+                       ? static_cast<std::int8_t>(isola::NO_SQUARE)
+                       : static_cast<std::int8_t>(entry.pv[i].arrow)};
+      // Another position with the same key
+      if (!line.isLegal(move)) {
+        return std::nullopt;
+      }
+      analysis.pv.push_back(move);
+      line.makeMove(move);
+    }
+    return analysis;
+  }
+
+  // Not thread safe, the caller serializes
+  void add(const isola::BasicGameState<G> &state, const Analysis &analysis) {
+    CacheEntry entry;
+    entry.key = state.hash();
+    entry.nodes = analysis.nodes;
+    entry.score = analysis.score;
+    entry.depth = static_cast<std::uint8_t>(analysis.depth);
+    entry.pvLength = static_cast<std::uint8_t>(
+        std::min<std::size_t>(analysis.pv.size(), PV_MOVES));
+    for (int i = 0; i < entry.pvLength; ++i) {
+      const isola::Move &move = analysis.pv[i];
+      entry.pv[i].step = static_cast<std::uint8_t>(move.to);
+      entry.pv[i].arrow = move.arrow == isola::NO_SQUARE
+                              ? isola::NO_ARROW
+                              : static_cast<std::uint8_t>(move.arrow);
+    }
+    m_entries[entry.key] = entry;
+    if (m_file) {
+      m_ok &= std::fwrite(&entry, sizeof(entry), 1, m_file) == 1;
+    }
+  }
+
+  bool close() {
+    if (m_file) {
+      m_ok &= std::fclose(m_file) == 0;
+      m_file = nullptr;
+    }
+    return m_ok;
+  }
+};
+
+// Whether `analysis` stands in for a search with `limits`
+bool answers(const Analysis &analysis, const isola::SearchLimits &limits) {
+  if (isola::isWinScore(analysis.score)) {
+    return true;
+  }
+  return limits.moveTime.count() == 0 && limits.maxNodes == 0 &&
+         analysis.depth >= limits.maxDepth;
+}
+
+// Jobs 0 to count - 1, a contiguous block of them per thread. A thread takes
+// its own from the front, and once it has none left moves the back half of
+// the largest remaining block over to itself
+class StealingQueues {
+  struct alignas(64) Block {
+    std::mutex mutex;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+  };
+
+  std::unique_ptr<Block[]> m_blocks;
+  std::size_t m_count;
+  std::atomic<std::uint64_t> m_steals{0};
+
+public:
+  StealingQueues(std::size_t jobs, int threads)
+      : m_blocks(new Block[threads]), m_count(threads) {
+    for (std::size_t i = 0; i < m_count; ++i) {
+      m_blocks[i].begin = jobs * i / m_count;
+      m_blocks[i].end = jobs * (i + 1) / m_count;
+    }
+  }
+
+  // The next job for `thread`, nothing once every job has been handed out
+  std::optional<std::size_t> next(std::size_t thread) {
+    Block &own = m_blocks[thread];
+    for (;;) {
+      {
+        std::lock_guard lock(own.mutex);
+        if (own.begin < own.end) {
+          return own.begin++;
+        }
+      }
+      if (!steal(thread)) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  std::uint64_t steals() const {
+    return m_steals.load(std::memory_order_relaxed);
+  }
+
+private:
+  bool steal(std::size_t thread) {
+    for (;;) {
+      std::size_t victim = m_count;
+      std::size_t most = 0;
+      for (std::size_t i = 0; i < m_count; ++i) {
+        std::lock_guard lock(m_blocks[i].mutex);
+        if (i != thread && m_blocks[i].end - m_blocks[i].begin > most) {
+          most = m_blocks[i].end - m_blocks[i].begin;
+          victim = i;
+        }
+      }
+      if (victim == m_count) {
+        return false;
+      }
+
+      std::size_t begin;
+      std::size_t end;
+      {
+        std::lock_guard lock(m_blocks[victim].mutex);
+        Block &block = m_blocks[victim];
+        // Emptied since it was looked at, look again
+        if (block.begin == block.end) {
+          continue;
+        }
+        end = block.end;
+        block.end -= (block.end - block.begin + 1) / 2;
+        begin = block.end;
+      }
+      std::lock_guard lock(m_blocks[thread].mutex);
+      m_blocks[thread].begin = begin;
+      m_blocks[thread].end = end;
+      m_steals.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+};
+
+// Side to move of a position without one, B moves first and every turn
+// kills two squares
+template <class G> int impliedSide(const isola::BasicBoard<G> &board) {
+  return isola::popCount(board.dead()) / 2 % 2;
+}
+
+// The positions of a text file, false with a message on a malformed one
+template <class G>
+bool readPositions(const char *path, std::vector<Position<G>> &positions) {
+  std::ifstream in(path);
+  if (!in) {
+    std::perror(path);
+    return false;
+  }
+
+  std::string rows;
+  int rowCount = 0;
+  int firstLine = 0;
+  bool complete = false;
+  auto finish = [&](std::optional<int> side) {
+    std::optional<isola::BasicBoard<G>> board =
+        isola::BasicBoard<G>::fromString(rows);
+    if (!board) {
+      std::fprintf(stderr, "%s:%d: not a %dx%d board\n", path, firstLine,
+                   G::ROWS, G::COLS);
+      return false;
+    }
+    positions.push_back(
+        {.state = isola::BasicGameState<G>(
+             *board, side ? *side : impliedSide<G>(*board)),
+         .label = std::to_string(firstLine)});
+    rows.clear();
+    rowCount = 0;
+    complete = false;
+    return true;
+  };
+
+  std::string line;
+  for (int number = 1; std::getline(in, line); ++number) {
+    std::string_view rest = line;
+    if (!rest.empty() && rest.front() == '#') {
+      continue;
+    }
+    for (std::string_view token = isola::nextToken(rest); !token.empty();
+         token = isola::nextToken(rest)) {
+      if (complete) {
+        bool sided =
+            token == isola::PLAYER_ONE || token == isola::PLAYER_TWO;
+        if (!finish(sided ? std::optional<int>(token == isola::PLAYER_TWO)
+                          : std::nullopt)) {
+          return false;
+        }
+        if (sided) {
+          continue;
+        }
+      }
+
+      if (rowCount == 0) {
+        firstLine = number;
+      } else {
+        rows += '/';
+      }
+      rows += token;
+      bool whole = token.find('/') != std::string_view::npos;
+      if (!whole && token.size() != G::COLS) {
+        std::fprintf(stderr, "%s:%d: expected a row of %d squares, not %.*s\n",
+                     path, number, G::COLS, static_cast<int>(token.size()),
+                     token.data());
+        return false;
+      }
+      rowCount = whole ? G::ROWS : rowCount + 1;
+      complete = rowCount >= G::ROWS;
+    }
+  }
+  if (complete) {
+    return finish(std::nullopt);
+  }
+  if (rowCount > 0) {
+    std::fprintf(stderr, "%s:%d: the board is cut short\n", path, firstLine);
+    return false;
+  }
+  return true;
+}
+
+// Every position a game of the record file was played on
+template <class G>
+bool readRecords(const char *path, std::vector<Position<G>> &positions) {
+  std::optional<isola::RecordFile<G>> records =
+      isola::RecordFile<G>::open(path);
+  if (!records) {
+    std::fprintf(stderr, "%s is not a record file for this board\n", path);
+    return false;
+  }
+  for (std::size_t game = 0; game < records->size(); ++game) {
+    std::size_t before = positions.size();
+    int turn = 0;
+    bool valid = (*records)[game]
+                     .replay([&](const isola::BasicGameState<G> &state,
+                                 isola::Move) {
+                       positions.push_back(
+                           {.state = state,
+                            .label = std::to_string(game) + "." +
+                                     std::to_string(turn++)});
+                     })
+                     .has_value();
+    if (!valid) {
+      std::fprintf(stderr, "%s: game %zu is corrupt, skipped\n", path, game);
+      positions.erase(positions.begin() + before, positions.end());
+    }
+  }
+  return true;
+}
+
+// Drops every position seen before, keeping the first
+template <class G> void removeDuplicates(std::vector<Position<G>> &positions) {
+  std::unordered_map<std::uint64_t, std::vector<std::size_t>> seen;
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    const isola::BasicGameState<G> &state = positions[i].state;
+    std::vector<std::size_t> &same = seen[state.hash()];
+    bool duplicate = std::any_of(same.begin(), same.end(), [&](auto j) {
+      const isola::BasicGameState<G> &other = positions[j].state;
+      return other.dead() == state.dead() &&
+             other.player(0) == state.player(0) &&
+             other.player(1) == state.player(1) &&
+             other.sideToMove() == state.sideToMove();
+    });
+    if (!duplicate) {
+      same.push_back(kept);
+      if (kept != i) {
+        positions[kept] = std::move(positions[i]);
+      }
+      ++kept;
+    }
+  }
+  positions.resize(kept);
+}
+
+// The engine plays the only move it has a candidate for without searching,
+// the score of such a position is the one after it
+template <class G>
+Analysis analyze(isola::BasicEngine<G> &engine,
+                 const isola::BasicGameState<G> &state,
+                 const isola::SearchLimits &limits) {
+  if (state.isGameOver()) {
+    return {.score = -isola::SCORE_WIN};
+  }
+  isola::SearchResult result = engine.search(state, limits);
+  if (result.nodes > 0) {
+    return {.score = result.score,
+            .depth = result.depth,
+            .nodes = result.nodes,
+            .elapsed = result.elapsed,
+            .pv = engine.principalVariation(state, result.bestMove,
+                                            PV_MOVES)};
+  }
+
+  isola::BasicGameState<G> next = state;
+  next.makeMove(result.bestMove);
+  Analysis analysis = analyze(engine, next, limits);
+  // One ply further from the end
+  analysis.score = -analysis.score;
+  if (analysis.score >= isola::SCORE_WIN_BOUND) {
+    --analysis.score;
+  } else if (analysis.score <= -isola::SCORE_WIN_BOUND) {
+    ++analysis.score;
+  }
+  analysis.nodes += result.nodes;
+  analysis.elapsed += result.elapsed;
+  analysis.pv.insert(analysis.pv.begin(), result.bestMove);
+  if (analysis.pv.size() > PV_MOVES) {
+    analysis.pv.pop_back();
+  }
+  return analysis;
+}
+
+template <class G>
+void print(const Position<G> &position, const Analysis &analysis) {
+  std::string line = position.label;
+  line += ' ';
+  std::string board = position.state.toBoard().toString();
+  for (std::size_t i = 0; i < board.size(); ++i) {
+    // The last row ends the board, the others are separated by '/'
+    if (board[i] != '\n') {
+      line += board[i];
+    } else if (i + 1 < board.size()) {
+      line += '/';
+    }
+  }
+  line += position.state.sideToMove() == 0 ? " B" : " W";
+
+  char numbers[128];
+  std::snprintf(
+      numbers, sizeof(numbers), " score %d depth %d nodes %llu time %lld%s pv",
+      analysis.score, analysis.depth,
+      static_cast<unsigned long long>(analysis.nodes),
+      static_cast<long long>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              analysis.elapsed)
+              .count()),
+      analysis.cached ? " cached" : "");
+  line += numbers;
+  for (const isola::Move &move : analysis.pv) {
+    char text[isola::MOVE_TEXT_SIZE];
+    line += ' ';
+    line.append(text, isola::formatMove<G>(move, text));
+  }
+  line += '\n';
+  std::fwrite(line.data(), 1, line.size(), stdout);
+}
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  bool otherLimit = false;
+  bool depthGiven = false;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg{argv[i]};
+    const char *value = argv[i + 1];
+
+    if (arg == "--positions") {
+      config.positions = value;
+    } else if (arg == "--records") {
+      config.records = value;
+    } else if (arg == "--cache") {
+      config.cache = value;
+    } else if (arg == "--tablebase") {
+      config.tablebase = value;
+    } else if (arg == "--threads") {
+      config.threads = std::max(1, std::atoi(value));
+    } else if (arg == "--hash") {
+      config.hashMB = std::max(1ull, std::strtoull(value, nullptr, 10));
+    } else if (arg == "--depth") {
+      config.limits.maxDepth = std::clamp(std::atoi(value), 1, isola::MAX_PLY);
+      depthGiven = true;
+    } else if (arg == "--movetime") {
+      config.limits.moveTime = std::chrono::milliseconds{std::atoi(value)};
+      otherLimit = true;
+    } else if (arg == "--nodes") {
+      config.limits.maxNodes = std::strtoull(value, nullptr, 10);
+      otherLimit = true;
+    } else if (arg == "--size") {
+      auto size = isola::parseBoardSize(value);
+      if (!size) {
+        return false;
+      }
+      config.size = *size;
+    } else {
+      return false;
+    }
+  }
+  // A time or node budget replaces the default depth, not one given too
+  if (otherLimit && !depthGiven) {
+    config.limits.maxDepth = isola::MAX_PLY;
+  }
+  return argc % 2 == 1 && (config.positions != nullptr) !=
+                              (config.records != nullptr);
+}
+
+template <class G> int run(const Config &config) {
+  std::vector<Position<G>> positions;
+  if (config.positions ? !readPositions(config.positions, positions)
+                       : !readRecords(config.records, positions)) {
+    return EXIT_FAILURE;
+  }
+  std::size_t read = positions.size();
+  removeDuplicates(positions);
+
+  std::optional<isola::Tablebase> tablebase;
+  if (config.tablebase &&
+      !(tablebase = isola::Tablebase::open(config.tablebase))) {
+    std::fprintf(stderr, "%s is not an endgame tablebase\n",
+                 config.tablebase);
+    return EXIT_FAILURE;
+  }
+  AnalysisCache<G> cache;
+  if (config.cache && !cache.open(config.cache)) {
+    std::fprintf(stderr, "%s is not an analysis cache for this board\n",
+                 config.cache);
+    return EXIT_FAILURE;
+  }
+
+  // Cached and finished positions are printed right away, the rest searched
+  std::vector<std::size_t> jobs;
+  std::size_t cached = 0;
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    const isola::BasicGameState<G> &state = positions[i].state;
+    if (state.isGameOver()) {
+      print(positions[i], Analysis{.score = -isola::SCORE_WIN});
+      continue;
+    }
+    std::optional<Analysis> analysis = cache.find(state);
+    if (analysis && answers(*analysis, config.limits)) {
+      print(positions[i], *analysis);
+      ++cached;
+      continue;
+    }
+    jobs.push_back(i);
+  }
+  std::fflush(stdout);
+
+  StealingQueues queues(jobs.size(), config.threads);
+  std::mutex mutex;
+  std::atomic<std::uint64_t> nodes{0};
+  Clock::time_point start = Clock::now();
+  {
+    std::vector<std::jthread> pool;
+    for (int i = 0; i < config.threads; ++i) {
+      pool.emplace_back([&, i] {
+        isola::BasicEngine<G> engine;
+        engine.setHashSize(config.hashMB);
+        if (tablebase) {
+          engine.setTablebase(&*tablebase);
+        }
+        for (std::optional<std::size_t> job = queues.next(i); job;
+             job = queues.next(i)) {
+          const Position<G> &position = positions[jobs[*job]];
+          Analysis analysis = analyze(engine, position.state, config.limits);
+          nodes.fetch_add(analysis.nodes, std::memory_order_relaxed);
+
+          std::lock_guard lock(mutex);
+          print(position, analysis);
+          std::fflush(stdout);
+          cache.add(position.state, analysis);
+        }
+      });
+    }
+  }
+
+  if (!cache.close()) {
+    std::perror(config.cache);
+    return EXIT_FAILURE;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::fprintf(stderr,
+               "%zu positions, %zu different, %zu cached, %zu searched in "
+               "%.2f s, %llu nodes, %llu steals\n",
+               read, positions.size(), cached, jobs.size(), seconds,
+               static_cast<unsigned long long>(nodes.load()),
+               static_cast<unsigned long long>(queues.steals()));
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr,
+                 "Usage: %s (--positions <file> | --records <file>)\n"
+                 "       [--cache <file>] [--threads <n>] [--hash <mb>]\n"
+                 "       [--depth <n>] [--movetime <ms>] [--nodes <n>]\n"
+                 "       [--tablebase <file>] [--size <rows>x<cols>]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  isola::BoardSize size = config.size;
+  if (config.records) {
+    std::optional<isola::BoardSize> recorded =
+        isola::recordBoardSize(config.records);
+    if (!recorded) {
+      std::fprintf(stderr, "%s is not a record file\n", config.records);
+      return EXIT_FAILURE;
+    }
+    size = *recorded;
+  }
+  int status = EXIT_FAILURE;
+  if (!isola::dispatchGeometry(size,
+                               [&]<class G>() { status = run<G>(config); })) {
+    std::fprintf(stderr, "%dx%d boards are not supported\n", size.rows,
+                 size.cols);
+  }
+  return status;
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Scoring many positions in one call.
+
+    evalReach scores a position from the side to move's point of view with two
+    features of each player:
+        mobility   free squares it can step to
+        reach      free squares it can get to within two steps
+    as (mobility difference) * 2 + (reach difference).
+
+    evaluateBatch computes exactly the same scores for a whole array of
+    positions. A GameState with 64-bit bitboards is 32 bytes, so the SIMD
+    kernels load each position as one vector and transpose a chunk of them in
+    registers into one position per 64-bit lane. The player squares become
+    bits with variable shifts and their neighbours come from dilating those
+    bits, so no table is looked up per lane. The features of a full chunk
+    are then computed with one SIMD instruction per step of the scalar code:
+    8 lanes with AVX-512 (VPOPCNTQ counts the bits), 4 lanes with AVX2 (bits
+    counted with a nibble lookup table), or evalReach in a plain loop
+    elsewhere. The kernel is picked once at runtime from what the CPU
+    supports, so the binary still runs on any x86-64 machine. Boards with
+    128-bit bitboards always use the plain loop.
+
+    clang-format on
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ISOLA_X86_KERNELS 1
+#endif
+
+#include "bitboard.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+
+namespace isola {
+
+template <class G> Score evalReach(const BasicGameState<G> &state) {
+  using Bitboard = typename G::Bitboard;
+
+  Bitboard free = state.free();
+  int us = state.sideToMove();
+  Bitboard ours = G::neighbors(state.player(us)) & free;
+  Bitboard theirs = G::neighbors(state.player(us ^ 1)) & free;
+
+  int mobility = popCount(ours) - popCount(theirs);
+  int reach = popCount(G::dilate(ours) & free) -
+              popCount(G::dilate(theirs) & free);
+  return mobility * 2 + reach;
+}
+
+enum class BatchKernel { Scalar, Avx2, Avx512 };
+
+inline const char *batchKernelName(BatchKernel kernel) {
+  switch (kernel) {
+  case BatchKernel::Avx2:
+    return "avx2";
+  case BatchKernel::Avx512:
+    return "avx512";
+  default:
+    return "scalar";
+  }
+}
+
+// Whether this machine can run `kernel`
+inline bool supportsBatchKernel(BatchKernel kernel) {
+#ifdef ISOLA_X86_KERNELS
+  switch (kernel) {
+  case BatchKernel::Avx2:
+    return __builtin_cpu_supports("avx2");
+  case BatchKernel::Avx512:
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vpopcntdq");
+  default:
+    return true;
+  }
+#else
+  return kernel == BatchKernel::Scalar;
+#endif
+}
+
+inline BatchKernel bestBatchKernel() {
+  static const BatchKernel best = supportsBatchKernel(BatchKernel::Avx512)
+                                      ? BatchKernel::Avx512
+                                  : supportsBatchKernel(BatchKernel::Avx2)
+                                      ? BatchKernel::Avx2
+                                      : BatchKernel::Scalar;
+  return best;
+}
+
+namespace detail {
+
+// Positions scored per kernel call, one AVX-512 vector or two AVX2 ones
+constexpr std::size_t BATCH_LANES = 8;
+
+// The SIMD kernels load a position as one 32 byte vector: the dead squares,
+// both player squares, the side to move and the hash, one 64-bit word each
+template <class G>
+constexpr bool PACKED_STATES =
+    sizeof(typename G::Bitboard) == sizeof(std::uint64_t) &&
+    sizeof(BasicGameState<G>) == 32 && BasicGameState<G>::deadOffset() == 0 &&
+    BasicGameState<G>::playersOffset() == 8 &&
+    BasicGameState<G>::sideOffset() == 16;
+
+template <class G>
+void scoreScalar(const BasicGameState<G> *states, int *out) {
+  for (std::size_t i = 0; i < BATCH_LANES; ++i) {
+    out[i] = evalReach(states[i]);
+  }
+}
+
+#ifdef ISOLA_X86_KERNELS
+
+#define ISOLA_AVX2 __attribute__((target("avx2")))
+#define ISOLA_AVX512 __attribute__((target("avx512f,avx512vpopcntdq")))
+
+ISOLA_AVX2 inline __m256i popCount256(__m256i v) {
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3,
+                                         2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3,
+                                         1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+  __m256i high = _mm256_shuffle_epi8(
+      table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+  // Sums the byte counts of every 64-bit lane
+  return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+template <class G> ISOLA_AVX2 inline __m256i dilate256(__m256i bb) {
+  const __m256i notFirst =
+      _mm256_set1_epi64x(static_cast<long long>(~G::FIRST_COL_MASK));
+  const __m256i notLast =
+      _mm256_set1_epi64x(static_cast<long long>(~G::LAST_COL_MASK));
+  const __m256i board =
+      _mm256_set1_epi64x(static_cast<long long>(G::BOARD_MASK));
+  __m256i row = _mm256_and_si256(
+      _mm256_or_si256(
+          bb,
+          _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(bb, 1), notFirst),
+                          _mm256_and_si256(_mm256_srli_epi64(bb, 1), notLast))),
+      board);
+  return _mm256_and_si256(
+      _mm256_or_si256(row, _mm256_or_si256(_mm256_slli_epi64(row, G::COLS),
+                                           _mm256_srli_epi64(row, G::COLS))),
+      board);
+}
+
+// Free squares and the free neighbours of the side to move and of the other
+// side, one position per 64-bit lane
+struct Lanes256 {
+  __m256i free;
+  __m256i ours;
+  __m256i theirs;
+};
+
+template <class G>
+ISOLA_AVX2 inline Lanes256 loadLanes256(const BasicGameState<G> *states) {
+  const __m256i *words = reinterpret_cast<const __m256i *>(states);
+  __m256i a = _mm256_loadu_si256(words);
+  __m256i b = _mm256_loadu_si256(words + 1);
+  __m256i c = _mm256_loadu_si256(words + 2);
+  __m256i d = _mm256_loadu_si256(words + 3);
+
+  // A 4x4 transpose of 64-bit words, the hashes are left behind
+  __m256i evenAB = _mm256_unpacklo_epi64(a, b);
+  __m256i evenCD = _mm256_unpacklo_epi64(c, d);
+  __m256i oddAB = _mm256_unpackhi_epi64(a, b);
+  __m256i oddCD = _mm256_unpackhi_epi64(c, d);
+  __m256i dead = _mm256_permute2x128_si256(evenAB, evenCD, 0x20);
+  __m256i side = _mm256_permute2x128_si256(evenAB, evenCD, 0x31);
+  __m256i players = _mm256_permute2x128_si256(oddAB, oddCD, 0x20);
+
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i board =
+      _mm256_set1_epi64x(static_cast<long long>(G::BOARD_MASK));
+  __m256i first = _mm256_sllv_epi64(
+      one, _mm256_and_si256(players, _mm256_set1_epi64x(0xffffffff)));
+  __m256i second = _mm256_sllv_epi64(one, _mm256_srli_epi64(players, 32));
+  __m256i free = _mm256_andnot_si256(
+      _mm256_or_si256(dead, _mm256_or_si256(first, second)), board);
+
+  // The side is an int, the upper half of its word is padding
+  __m256i secondMoves =
+      _mm256_cmpeq_epi64(_mm256_and_si256(side, one), one);
+  __m256i ours = _mm256_blendv_epi8(first, second, secondMoves);
+  __m256i theirs = _mm256_blendv_epi8(second, first, secondMoves);
+  // A player's own square is never free, so the dilation leaves just the
+  // neighbours
+  return {free, _mm256_and_si256(dilate256<G>(ours), free),
+          _mm256_and_si256(dilate256<G>(theirs), free)};
+}
+
+template <class G>
+ISOLA_AVX2 void scoreAvx2(const BasicGameState<G> *states, int *out) {
+  for (std::size_t i = 0; i < BATCH_LANES; i += 4) {
+    Lanes256 lanes = loadLanes256<G>(states + i);
+
+    __m256i mobility =
+        _mm256_sub_epi64(popCount256(lanes.ours), popCount256(lanes.theirs));
+    __m256i reach = _mm256_sub_epi64(
+        popCount256(_mm256_and_si256(dilate256<G>(lanes.ours), lanes.free)),
+        popCount256(_mm256_and_si256(dilate256<G>(lanes.theirs), lanes.free)));
+    __m256i score =
+        _mm256_add_epi64(_mm256_add_epi64(mobility, mobility), reach);
+
+    // The low halves of the four 64-bit scores are the four ints
+    __m256i packed = _mm256_permutevar8x32_epi32(
+        score, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm256_castsi256_si128(packed));
+  }
+}
+
+// The zero-masked forms of the shifts and the narrowing, with every lane
+// selected, are the plain instructions without the undefined source operand
+// GCC warns about
+constexpr __mmask8 ALL_LANES = 0xff;
+
+template <class G> ISOLA_AVX512 inline __m512i dilate512(__m512i bb) {
+  const __m512i notFirst =
+      _mm512_set1_epi64(static_cast<long long>(~G::FIRST_COL_MASK));
+  const __m512i notLast =
+      _mm512_set1_epi64(static_cast<long long>(~G::LAST_COL_MASK));
+  const __m512i board =
+      _mm512_set1_epi64(static_cast<long long>(G::BOARD_MASK));
+  __m512i left = _mm512_maskz_slli_epi64(ALL_LANES, bb, 1);
+  __m512i right = _mm512_maskz_srli_epi64(ALL_LANES, bb, 1);
+  __m512i row = _mm512_and_si512(
+      _mm512_or_si512(bb, _mm512_or_si512(_mm512_and_si512(left, notFirst),
+                                          _mm512_and_si512(right, notLast))),
+      board);
+  __m512i down = _mm512_maskz_slli_epi64(ALL_LANES, row, G::COLS);
+  __m512i up = _mm512_maskz_srli_epi64(ALL_LANES, row, G::COLS);
+  return _mm512_and_si512(_mm512_or_si512(row, _mm512_or_si512(down, up)),
+                          board);
+}
+
+template <class G>
+ISOLA_AVX512 void scoreAvx512(const BasicGameState<G> *states, int *out) {
+  // Two positions per vector, word w of position p is lane 4 * (p % 2) + w
+  const __m512i *words = reinterpret_cast<const __m512i *>(states);
+  __m512i a = _mm512_loadu_si512(words);
+  __m512i b = _mm512_loadu_si512(words + 1);
+  __m512i c = _mm512_loadu_si512(words + 2);
+  __m512i d = _mm512_loadu_si512(words + 3);
+
+  // Dead squares of four positions, then their sides, from each pair of
+  // vectors, and the player words likewise
+  const __m512i deadAndSide = _mm512_setr_epi64(0, 4, 8, 12, 2, 6, 10, 14);
+  const __m512i playerWords = _mm512_setr_epi64(1, 5, 9, 13, 1, 5, 9, 13);
+  const __m512i lowHalves = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+  const __m512i highHalves = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+  __m512i deadSideAB = _mm512_permutex2var_epi64(a, deadAndSide, b);
+  __m512i deadSideCD = _mm512_permutex2var_epi64(c, deadAndSide, d);
+  __m512i dead = _mm512_permutex2var_epi64(deadSideAB, lowHalves, deadSideCD);
+  __m512i side = _mm512_permutex2var_epi64(deadSideAB, highHalves, deadSideCD);
+  __m512i players = _mm512_permutex2var_epi64(
+      _mm512_permutex2var_epi64(a, playerWords, b), lowHalves,
+      _mm512_permutex2var_epi64(c, playerWords, d));
+
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512i board =
+      _mm512_set1_epi64(static_cast<long long>(G::BOARD_MASK));
+  __m512i first = _mm512_sllv_epi64(
+      one, _mm512_and_si512(players, _mm512_set1_epi64(0xffffffff)));
+  __m512i second =
+      _mm512_sllv_epi64(one, _mm512_maskz_srli_epi64(ALL_LANES, players, 32));
+  __m512i free = _mm512_andnot_si512(
+      _mm512_or_si512(dead, _mm512_or_si512(first, second)), board);
+
+  // The side is an int, the upper half of its word is padding
+  __mmask8 secondMoves = _mm512_test_epi64_mask(side, one);
+  __m512i ours = _mm512_and_si512(
+      dilate512<G>(_mm512_mask_blend_epi64(secondMoves, first, second)), free);
+  __m512i theirs = _mm512_and_si512(
+      dilate512<G>(_mm512_mask_blend_epi64(secondMoves, second, first)), free);
+
+  __m512i mobility =
+      _mm512_sub_epi64(_mm512_popcnt_epi64(ours), _mm512_popcnt_epi64(theirs));
+  __m512i reach = _mm512_sub_epi64(
+      _mm512_popcnt_epi64(_mm512_and_si512(dilate512<G>(ours), free)),
+      _mm512_popcnt_epi64(_mm512_and_si512(dilate512<G>(theirs), free)));
+  __m512i score = _mm512_add_epi64(_mm512_add_epi64(mobility, mobility), reach);
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out),
+                      _mm512_maskz_cvtepi64_epi32(ALL_LANES, score));
+}
+
+#undef ISOLA_AVX2
+#undef ISOLA_AVX512
+
+#endif
+
+} // namespace detail
+
+// out[i] = evalReach(states[i]) for every i < count, using `kernel` for all
+// full chunks of positions. The kernel has to be supported by this machine
+template <class G>
+void evaluateBatch(const BasicGameState<G> *states, std::size_t count,
+                   int *out, BatchKernel kernel = bestBatchKernel()) {
+  using detail::BATCH_LANES;
+
+  std::size_t full = 0;
+  if constexpr (detail::PACKED_STATES<G>) {
+    full = count - count % BATCH_LANES;
+    for (std::size_t i = 0; i < full; i += BATCH_LANES) {
+      switch (kernel) {
+#ifdef ISOLA_X86_KERNELS
+      case BatchKernel::Avx512:
+        detail::scoreAvx512<G>(states + i, out + i);
+        break;
+      case BatchKernel::Avx2:
+        detail::scoreAvx2<G>(states + i, out + i);
+        break;
+#endif
+      default:
+        detail::scoreScalar<G>(states + i, out + i);
+        break;
+      }
+    }
+  }
+
+  for (std::size_t i = full; i < count; ++i) {
+    out[i] = evalReach(states[i]);
+  }
+}
+
+} // namespace isola
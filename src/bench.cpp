@@ -0,0 +1,331 @@
+/*
+    clang-format off
+
+    isola_bench: reproducible numbers for the move generator and the search.
+
+        isola_bench [--depth <n>] [--smp <ms>] [--batch <n>]
+                    [--stats <file>] [--trace <file>]
+
+    Runs perft from the start position and a few midgame positions up to
+    --depth turns (default 4), plus the start positions of the bigger boards
+    so both the 64-bit and the 128-bit bitboards are covered. Checks every
+    count against the stored
+    reference and reports leaves per second. Exits with a non-zero status on
+    any mismatch, so a change to the board representation or the move
+    generator that alters the move tree can't go unnoticed.
+
+    --smp searches one midgame position for <ms> milliseconds with 1, 2, 4, ...
+    threads up to the hardware concurrency and reports the nodes per second
+    speedup of each thread count over a single thread.
+
+    --stats and --trace write what the --smp search with the most threads
+    counted, as JSON and as a Chrome trace of every thread's iterations (see
+    stats.hpp). Both need a build configured with -DISOLA_STATS=ON.
+
+    --batch scores <n> random positions with evalReach one at a time and then
+    with evaluateBatch on every kernel this machine supports, checks that all
+    of them agree and reports the positions per second of each.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "batch_eval.hpp"
+#include "board.hpp"
+#include "game_state.hpp"
+#include "perft.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int MAX_PERFT_DEPTH = 5;
+
+struct PerftPosition {
+  const char *name;
+  isola::BoardSize size;
+  // Nullptr for the start position
+  const char *board;
+  int sideToMove;
+  // Leaves at depth 1, 2, ... or zero where no reference is stored
+  std::uint64_t expected[MAX_PERFT_DEPTH];
+};
+
+// clang-format off
+constexpr PerftPosition POSITIONS[] = {
+    {"start", {7, 7},
+     "+++B+++\n"
+     "+++++++\n"
+     "+++++++\n"
+     "+++++++\n"
+     "+++++++\n"
+     "+++++++\n"
+     "+++W+++\n",
+     0, {230, 49500, 11522280, 2490907440, 0}},
+    {"open", {7, 7},
+     "A++AA++\n"
+     "+++++BA\n"
+     "+++++++\n"
+     "+++++++\n"
+     "A++++W+\n"
+     "++++A++\n"
+     "+++A+A+\n",
+     0, {228, 55944, 6897240, 943736640, 0}},
+    {"corner", {7, 7},
+     "++BAAAA\n"
+     "AA+A+++\n"
+     "++A++++\n"
+     "+++++++\n"
+     "++A++++\n"
+     "++A+A++\n"
+     "+++AAAW\n",
+     1, {64, 3720, 341040, 19950840, 1828008000}},
+    {"crowded", {7, 7},
+     "+++AAA+\n"
+     "++++AAA\n"
+     "++A+AB+\n"
+     "++AA+++\n"
+     "+W+++A+\n"
+     "AAA++A+\n"
+     "AAAAA++\n",
+     0, {104, 9600, 680064, 41441400, 1684322640}},
+    {"start8", {8, 8}, nullptr, 0, {305, 88500, 28282830, 0, 0}},
+    {"start9", {9, 9}, nullptr, 0, {390, 146300, 61161000, 0, 0}},
+};
+// clang-format on
+
+template <class G>
+isola::BasicGameState<G> loadPosition(const PerftPosition &position) {
+  if (!position.board) {
+    return isola::BasicGameState<G>();
+  }
+  auto board = isola::BasicBoard<G>::fromString(position.board);
+  if (!board) {
+    std::fprintf(stderr, "Bad board for position %s\n", position.name);
+    std::exit(EXIT_FAILURE);
+  }
+  return isola::BasicGameState<G>(*board, position.sideToMove);
+}
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct PerftTotals {
+  std::uint64_t nodes = 0;
+  double seconds = 0;
+};
+
+template <class G>
+bool runPerft(const PerftPosition &position, int maxDepth,
+              PerftTotals &totals) {
+  bool allMatch = true;
+  isola::BasicGameState<G> state = loadPosition<G>(position);
+
+  for (int depth = 1; depth <= maxDepth; ++depth) {
+    std::uint64_t expected = position.expected[depth - 1];
+    if (expected == 0) {
+      break;
+    }
+
+    Clock::time_point start = Clock::now();
+    std::uint64_t nodes = isola::perft(state, depth);
+    double seconds = secondsSince(start);
+
+    totals.nodes += nodes;
+    totals.seconds += seconds;
+
+    bool match = nodes == expected;
+    allMatch &= match;
+    std::printf("%-8s depth %d %12llu leaves %8.3f s %9.1f Mleaves/s  %s\n",
+                position.name, depth, static_cast<unsigned long long>(nodes),
+                seconds, seconds > 0 ? nodes / seconds / 1e6 : 0.0,
+                match ? "ok" : "MISMATCH");
+    if (!match) {
+      std::printf("%-8s expected %llu\n", position.name,
+                  static_cast<unsigned long long>(expected));
+    }
+  }
+  return allMatch;
+}
+
+bool runPerft(int maxDepth) {
+  bool allMatch = true;
+  PerftTotals totals;
+
+  for (const PerftPosition &position : POSITIONS) {
+    isola::dispatchGeometry(position.size, [&]<class G>() {
+      allMatch &= runPerft<G>(position, maxDepth, totals);
+    });
+  }
+
+  std::printf("total %llu leaves in %.3f s, %.1f Mleaves/s\n",
+              static_cast<unsigned long long>(totals.nodes), totals.seconds,
+              totals.seconds > 0 ? totals.nodes / totals.seconds / 1e6 : 0.0);
+  return allMatch;
+}
+
+bool writeStats(const char *path, const isola::SearchStats &stats,
+                bool (*write)(const isola::SearchStats &, std::FILE *)) {
+  std::FILE *file = std::fopen(path, "w");
+  bool ok = file && write(stats, file);
+  if (file) {
+    ok &= std::fclose(file) == 0;
+  }
+  if (!ok) {
+    std::fprintf(stderr, "Can't write %s\n", path);
+  }
+  return ok;
+}
+
+// Stats and trace paths are null when not wanted
+bool runSmp(std::chrono::milliseconds moveTime, const char *statsPath,
+            const char *tracePath) {
+  isola::GameState state =
+      loadPosition<isola::DefaultGeometry>(POSITIONS[1]);
+
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  double baseline = 0;
+  bool ok = true;
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    // A fresh engine each time so no thread count starts with a warm table
+    isola::Engine engine;
+    isola::SearchResult result =
+        engine.search(state, {.moveTime = moveTime}, threads);
+
+    double nps = result.nodesPerSecond();
+    if (threads == 1) {
+      baseline = nps;
+    }
+    std::printf("threads %2d depth %2d %12llu nodes %12.0f nodes/s  x%.2f\n",
+                threads, result.depth,
+                static_cast<unsigned long long>(result.nodes), nps,
+                baseline > 0 ? nps / baseline : 0.0);
+
+    if (threads * 2 > maxThreads) {
+      if (statsPath) {
+        ok &= writeStats(statsPath, engine.stats(), isola::writeStatsJson);
+      }
+      if (tracePath) {
+        ok &= writeStats(tracePath, engine.stats(), isola::writeChromeTrace);
+      }
+    }
+  }
+  return ok;
+}
+
+// Positions a few random moves into a game, as the search would score them
+std::vector<isola::GameState> randomPositions(std::size_t count) {
+  std::mt19937_64 random(count);
+  std::vector<isola::GameState> positions;
+  positions.reserve(count);
+
+  isola::GameState state;
+  isola::MoveList moves;
+  while (positions.size() < count) {
+    state.generateMoves(moves);
+    if (moves.empty() || random() % 32 == 0) {
+      state = isola::GameState();
+      continue;
+    }
+    state.makeMove(moves[random() % moves.size()]);
+    positions.push_back(state);
+  }
+  return positions;
+}
+
+bool runBatch(std::size_t count) {
+  std::vector<isola::GameState> positions = randomPositions(count);
+  std::vector<int> expected(count);
+  std::vector<int> scores(count);
+
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    expected[i] = isola::evalReach(positions[i]);
+  }
+  double baseline = secondsSince(start);
+  std::printf("%-8s %10zu positions %8.3f s %9.1f Mpos/s\n", "single",
+              count, baseline, count / baseline / 1e6);
+
+  bool allMatch = true;
+  for (isola::BatchKernel kernel :
+       {isola::BatchKernel::Scalar, isola::BatchKernel::Avx2,
+        isola::BatchKernel::Avx512}) {
+    if (!isola::supportsBatchKernel(kernel)) {
+      continue;
+    }
+    std::fill(scores.begin(), scores.end(), 0);
+    start = Clock::now();
+    isola::evaluateBatch(positions.data(), count, scores.data(), kernel);
+    double seconds = secondsSince(start);
+
+    bool match = scores == expected;
+    allMatch &= match;
+    std::printf("%-8s %10zu positions %8.3f s %9.1f Mpos/s  x%.2f  %s\n",
+                isola::batchKernelName(kernel), count, seconds,
+                count / seconds / 1e6, baseline / seconds,
+                match ? "ok" : "MISMATCH");
+  }
+  return allMatch;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int depth = 4;
+  std::chrono::milliseconds smpTime{0};
+  std::size_t batchSize = 0;
+  const char *statsPath = nullptr;
+  const char *tracePath = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg{argv[i]};
+    if (arg == "--depth" && i + 1 < argc) {
+      depth = std::atoi(argv[++i]);
+    } else if (arg == "--smp" && i + 1 < argc) {
+      smpTime = std::chrono::milliseconds{std::atoi(argv[++i])};
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batchSize = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--stats" && i + 1 < argc) {
+      statsPath = argv[++i];
+    } else if (arg == "--trace" && i + 1 < argc) {
+      tracePath = argv[++i];
+    } else {
+      std::fprintf(stderr,
+                   "Usage: %s [--depth <n>] [--smp <ms>] [--batch <n>] "
+                   "[--stats <file>] [--trace <file>]\n",
+                   argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if ((statsPath || tracePath) && !isola::STATS_ENABLED) {
+    std::fprintf(stderr, "%s: --stats and --trace need a build with "
+                         "ISOLA_STATS\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+  if ((statsPath || tracePath) && smpTime.count() <= 0) {
+    std::fprintf(stderr, "%s: --stats and --trace need --smp\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  bool ok = runPerft(std::min(depth, MAX_PERFT_DEPTH));
+  if (smpTime.count() > 0) {
+    ok &= runSmp(smpTime, statsPath, tracePath);
+  }
+  if (batchSize > 0) {
+    ok &= runBatch(batchSize);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
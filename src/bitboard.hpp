@@ -0,0 +1,237 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Bitboard primitives for the Isola board.
+
+    Every square of the board maps to one bit of a mask, numbered row-major
+    from the top left corner:
+
+        square = row * COLS + col
+
+    The board size is a template parameter: Geometry<Rows, Cols> holds the
+    mask type, the board mask and the neighbour tables of one size, all
+    computed at compile time, and everything above it (GameState, the search,
+    ...) is instantiated per geometry. Boards up to 64 squares (8 by 8) use a
+    64-bit mask, bigger ones up to 128 squares (11 by 11) a 128-bit one.
+    The standard 7 by 7 board uses bits 0..48 of a 64-bit word and the rest
+    of the word is always zero.
+
+    dispatchGeometry turns a board size only known at runtime into a call of
+    the instantiation for it.
+
+    clang-format on
+*/
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace isola {
+
+using Bitboard64 = std::uint64_t;
+using Bitboard128 = unsigned __int128;
+using Square = int;
+
+constexpr Square NO_SQUARE = -1;
+
+// Squares have to fit in the int8_t fields of a Move
+constexpr int MAX_BOARD_SQUARES = 128;
+
+constexpr int popCount(Bitboard64 bb) { return std::popcount(bb); }
+constexpr int popCount(Bitboard128 bb) {
+  return std::popcount(static_cast<std::uint64_t>(bb)) +
+         std::popcount(static_cast<std::uint64_t>(bb >> 64));
+}
+
+// Index of the lowest set bit, bb must not be empty
+constexpr Square lowestSquare(Bitboard64 bb) {
+  assert(bb != 0);
+  return std::countr_zero(bb);
+}
+constexpr Square lowestSquare(Bitboard128 bb) {
+  assert(bb != 0);
+  auto low = static_cast<std::uint64_t>(bb);
+  return low ? std::countr_zero(low)
+             : 64 + std::countr_zero(static_cast<std::uint64_t>(bb >> 64));
+}
+
+// Removes and returns the lowest set bit, bb must not be empty
+template <class Mask> constexpr Square popLowest(Mask &bb) {
+  Square sq = lowestSquare(bb);
+  bb &= bb - 1;
+  return sq;
+}
+
+// The n-th lowest set bit of bb, counting from zero, bb must have more than n
+// bits set. A single pdep where BMI2 is available
+inline Square nthSquare(Bitboard64 bb, int n) {
+  assert(n >= 0 && n < popCount(bb));
+#if defined(__BMI2__)
+  return lowestSquare(Bitboard64{_pdep_u64(Bitboard64{1} << n, bb)});
+#else
+  for (; n > 0; --n) {
+    bb &= bb - 1;
+  }
+  return lowestSquare(bb);
+#endif
+}
+inline Square nthSquare(Bitboard128 bb, int n) {
+  auto low = static_cast<std::uint64_t>(bb);
+  int lowCount = popCount(low);
+  if (n < lowCount) {
+    return nthSquare(low, n);
+  }
+  return 64 + nthSquare(static_cast<std::uint64_t>(bb >> 64), n - lowCount);
+}
+
+template <int Rows, int Cols> struct Geometry {
+  static_assert(Rows >= 3 && Cols >= 3, "board is too small to play on");
+  static_assert(Rows * Cols <= MAX_BOARD_SQUARES,
+                "board does not fit in a 128-bit bitboard");
+
+  static constexpr int ROWS = Rows;
+  static constexpr int COLS = Cols;
+  static constexpr int SQUARES = Rows * Cols;
+
+  using Bitboard =
+      std::conditional_t<SQUARES <= 64, Bitboard64, Bitboard128>;
+
+  // All squares that are on the board
+  static constexpr Bitboard BOARD_MASK =
+      SQUARES == 8 * sizeof(Bitboard) ? ~Bitboard{0}
+                                      : (Bitboard{1} << SQUARES) - 1;
+
+  static constexpr Bitboard FIRST_COL_MASK = [] {
+    Bitboard bb = 0;
+    for (int row = 0; row < Rows; ++row) {
+      bb |= Bitboard{1} << (row * Cols);
+    }
+    return bb;
+  }();
+
+  static constexpr Bitboard LAST_COL_MASK = FIRST_COL_MASK << (Cols - 1);
+
+  // King-move neighbours of every square
+  static constexpr std::array<Bitboard, SQUARES> NEIGHBOR_MASKS = [] {
+    std::array<Bitboard, SQUARES> masks{};
+    for (int row = 0; row < Rows; ++row) {
+      for (int col = 0; col < Cols; ++col) {
+        for (int dr = -1; dr <= 1; ++dr) {
+          for (int dc = -1; dc <= 1; ++dc) {
+            int r = row + dr;
+            int c = col + dc;
+            if ((dr != 0 || dc != 0) && r >= 0 && r < Rows && c >= 0 &&
+                c < Cols) {
+              masks[row * Cols + col] |= Bitboard{1} << (r * Cols + c);
+            }
+          }
+        }
+      }
+    }
+    return masks;
+  }();
+
+  static constexpr Square toSquare(int row, int col) {
+    return row * Cols + col;
+  }
+  static constexpr int rowOf(Square sq) { return sq / Cols; }
+  static constexpr int colOf(Square sq) { return sq % Cols; }
+
+  static constexpr bool onBoard(int row, int col) {
+    return row >= 0 && row < Rows && col >= 0 && col < Cols;
+  }
+
+  static constexpr Bitboard squareBit(Square sq) {
+    assert(sq >= 0 && sq < SQUARES);
+    return Bitboard{1} << sq;
+  }
+
+  // Squares within one king move of any square in bb, including bb itself
+  static constexpr Bitboard dilate(Bitboard bb) {
+    // The step right from the last square lands past the board, where the
+    // step up would bring it back onto the last row
+    Bitboard row =
+        (bb | ((bb << 1) & ~FIRST_COL_MASK) | ((bb >> 1) & ~LAST_COL_MASK)) &
+        BOARD_MASK;
+    return (row | (row << Cols) | (row >> Cols)) & BOARD_MASK;
+  }
+
+  static constexpr Bitboard neighbors(Square sq) {
+    assert(sq >= 0 && sq < SQUARES);
+    return NEIGHBOR_MASKS[sq];
+  }
+
+  // Number of free squares a piece on sq could step to
+  static constexpr int mobility(Square sq, Bitboard free) {
+    return popCount(neighbors(sq) & free);
+  }
+
+  static constexpr bool hasMove(Square sq, Bitboard free) {
+    return (neighbors(sq) & free) != 0;
+  }
+};
+
+// The board the game is normally played on
+using DefaultGeometry = Geometry<7, 7>;
+
+namespace detail {
+
+template <class G> constexpr bool checkGeometry() {
+  for (Square sq = 0; sq < G::SQUARES; ++sq) {
+    if (G::dilate(G::squareBit(sq)) != (G::neighbors(sq) | G::squareBit(sq))) {
+      return false;
+    }
+  }
+  return popCount(G::neighbors(G::toSquare(0, 0))) == 3 &&
+         popCount(G::neighbors(G::toSquare(0, G::COLS / 2))) == 5 &&
+         popCount(G::neighbors(G::toSquare(1, 1))) == 8 &&
+         popCount(G::BOARD_MASK) == G::SQUARES;
+}
+
+} // namespace detail
+
+static_assert(detail::checkGeometry<Geometry<7, 7>>());
+static_assert(detail::checkGeometry<Geometry<8, 8>>());
+static_assert(detail::checkGeometry<Geometry<9, 9>>());
+static_assert(detail::checkGeometry<Geometry<11, 11>>());
+static_assert(detail::checkGeometry<Geometry<6, 9>>());
+
+struct BoardSize {
+  int rows;
+  int cols;
+};
+
+template <class... Geometries> struct GeometryList {};
+
+// Board sizes the tools are built for. Each one instantiates the whole
+// engine, so only sizes that are actually played belong here
+using SupportedGeometries =
+    GeometryList<Geometry<7, 7>, Geometry<8, 8>, Geometry<9, 9>,
+                 Geometry<6, 6>, Geometry<10, 10>, Geometry<11, 11>>;
+
+template <class F, class... Geometries>
+bool dispatchGeometry(int rows, int cols, F &&f, GeometryList<Geometries...>) {
+  return ((rows == Geometries::ROWS && cols == Geometries::COLS &&
+           (f.template operator()<Geometries>(), true)) ||
+          ...);
+}
+
+// Calls f.template operator()<G>() with the geometry of a rows by cols
+// board, false when no supported geometry has that size
+template <class F> bool dispatchGeometry(int rows, int cols, F &&f) {
+  return dispatchGeometry(rows, cols, f, SupportedGeometries{});
+}
+
+template <class F> bool dispatchGeometry(BoardSize size, F &&f) {
+  return dispatchGeometry(size.rows, size.cols, f);
+}
+
+} // namespace isola
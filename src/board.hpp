@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "bitboard.hpp"
+
+namespace isola {
+
+constexpr const char *EMPTY_SPOT = "+";
+constexpr const char *DEAD_CELL = "A";
+constexpr const char *PLAYER_ONE = "B";
+constexpr const char *PLAYER_TWO = "W";
+
+/*
+    The board only stores which squares are dead and where each player stands.
+    The cell symbols are derived from that on demand, so copying a board is
+    a plain copy of a mask and two squares and never allocates. The text
+    forms have a fixed size per board size, so they can also be written into
+    a buffer the caller keeps around instead of a new string each time.
+*/
+template <class G> class BasicBoard {
+  using Bitboard = typename G::Bitboard;
+
+  Bitboard m_dead = 0;
+  Square m_players[2] = {NO_SQUARE, NO_SQUARE};
+
+  static constexpr std::size_t digits(int n) {
+    return n < 10 ? 1 : 1 + digits(n / 10);
+  }
+
+  // Row labels are right aligned to the widest one
+  static constexpr std::size_t LABEL_WIDTH = digits(G::ROWS);
+
+public:
+  // Characters of toString() and toPrettyString()
+  static constexpr std::size_t TEXT_SIZE = G::ROWS * (G::COLS + 1);
+  static constexpr std::size_t PRETTY_TEXT_SIZE =
+      (G::ROWS + 1) * (LABEL_WIDTH + 1 + G::COLS + 1);
+
+  BasicBoard() = default;
+
+  void setCell(int row, int col, std::string_view symbol) {
+    assert(G::onBoard(row, col));
+    Square sq = G::toSquare(row, col);
+
+    // A cell holds exactly one thing, so clear whatever was there first
+    m_dead &= ~G::squareBit(sq);
+    for (Square &player : m_players) {
+      if (player == sq) {
+        player = NO_SQUARE;
+      }
+    }
+
+    if (symbol == DEAD_CELL) {
+      m_dead |= G::squareBit(sq);
+    } else if (symbol == PLAYER_ONE) {
+      m_players[0] = sq;
+    } else if (symbol == PLAYER_TWO) {
+      m_players[1] = sq;
+    } else {
+      assert(symbol == EMPTY_SPOT);
+    }
+  }
+
+  std::string_view getCell(int row, int col) const {
+    assert(G::onBoard(row, col));
+    Square sq = G::toSquare(row, col);
+
+    if (m_players[0] == sq) {
+      return PLAYER_ONE;
+    } else if (m_players[1] == sq) {
+      return PLAYER_TWO;
+    } else if (m_dead & G::squareBit(sq)) {
+      return DEAD_CELL;
+    }
+    return EMPTY_SPOT;
+  }
+
+  std::string toString() const {
+    std::string str(TEXT_SIZE, '\0');
+    writeString(str);
+    return str;
+  }
+
+  // Writes toString() into `out` without the terminating zero and returns
+  // the characters written, nothing when `out` is shorter than TEXT_SIZE
+  std::size_t writeString(std::span<char> out) const {
+    if (out.size() < TEXT_SIZE) {
+      return 0;
+    }
+    char *next = out.data();
+    for (int row = 0; row < rows(); ++row) {
+      next = writeRow(next, row);
+    }
+    return next - out.data();
+  }
+  // Reads the toString() format back, one line per row. Rows can also be
+  // separated by '/' to fit a board on one line. Returns nothing when the
+  // text isn't a full board with both players on it
+  static std::optional<BasicBoard> fromString(std::string_view text) {
+    BasicBoard board;
+    int row = 0;
+    while (!text.empty() && row < G::ROWS) {
+      std::size_t end = text.find_first_of("\n/");
+      std::string_view line = text.substr(0, end);
+      text = end == std::string_view::npos ? "" : text.substr(end + 1);
+
+      if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      if (line.size() != G::COLS) {
+        return std::nullopt;
+      }
+
+      for (int col = 0; col < G::COLS; ++col) {
+        std::string_view symbol = line.substr(col, 1);
+        if (symbol != EMPTY_SPOT && symbol != DEAD_CELL &&
+            symbol != PLAYER_ONE && symbol != PLAYER_TWO) {
+          return std::nullopt;
+        }
+        // Each player stands on exactly one square
+        if ((symbol == PLAYER_ONE && board.player(0) != NO_SQUARE) ||
+            (symbol == PLAYER_TWO && board.player(1) != NO_SQUARE)) {
+          return std::nullopt;
+        }
+        board.setCell(row, col, symbol);
+      }
+      ++row;
+    }
+
+    if (row != G::ROWS || board.player(0) == NO_SQUARE ||
+        board.player(1) == NO_SQUARE) {
+      return std::nullopt;
+    }
+    return board;
+  }
+
+  std::string toPrettyString() const {
+    std::string str(PRETTY_TEXT_SIZE, '\0');
+    writePrettyString(str);
+    return str;
+  }
+
+  // Same as writeString() for toPrettyString() and PRETTY_TEXT_SIZE
+  std::size_t writePrettyString(std::span<char> out) const {
+    if (out.size() < PRETTY_TEXT_SIZE) {
+      return 0;
+    }
+    // Column labels only get one character each, so columns past 9 count on
+    // from 0 again
+    char *next = out.data();
+    next = std::fill_n(next, LABEL_WIDTH + 1, ' ');
+    for (int col = 0; col < cols(); ++col) {
+      *next++ = static_cast<char>('0' + (col + 1) % 10);
+    }
+    *next++ = '\n';
+
+    for (int row = 0; row < rows(); ++row) {
+      char *label = next + LABEL_WIDTH;
+      for (int n = row + 1; n > 0; n /= 10) {
+        *--label = static_cast<char>('0' + n % 10);
+      }
+      std::fill(next, label, ' ');
+      next += LABEL_WIDTH;
+      *next++ = ' ';
+      next = writeRow(next, row);
+    }
+    return next - out.data();
+  }
+
+  Bitboard dead() const { return m_dead; }
+  Square player(int index) const { return m_players[index]; }
+
+  // Squares that are dead or have a player standing on them
+  Bitboard occupied() const {
+    Bitboard bb = m_dead;
+    for (Square player : m_players) {
+      if (player != NO_SQUARE) {
+        bb |= G::squareBit(player);
+      }
+    }
+    return bb;
+  }
+
+  // Squares a player could step onto or an arrow could hit
+  Bitboard free() const { return G::BOARD_MASK & ~occupied(); }
+
+  int rows() const { return G::ROWS; }
+  int cols() const { return G::COLS; }
+
+private:
+  // The cells of `row` and a newline, every symbol is one character
+  char *writeRow(char *out, int row) const {
+    for (int col = 0; col < cols(); ++col) {
+      *out++ = getCell(row, col)[0];
+    }
+    *out++ = '\n';
+    return out;
+  }
+};
+
+using Board = BasicBoard<DefaultGeometry>;
+
+} // namespace isola
@@ -0,0 +1,212 @@
+/*
+    clang-format off
+
+    isola_book: builds the opening book the engine plays its first turns
+    from.
+
+        isola_book [--out <file>] [--plies <n>] [--depth <n>]
+                   [--movetime <ms>] [--threads <n>] [--hash <mb>]
+                   [--size <rows>x<cols>] [--symmetry 0|1]
+
+    The book is built once for each side. Positions where that side is to
+    move within the first --plies turns (default 3) are searched to --depth
+    (default 8) or for --movetime, and only the best move is followed from
+    them. Every reply of the other side is followed. So each side can look
+    up its move for as long as it keeps playing the book, whatever the
+    opponent does. Each extra ply multiplies the number of positions to
+    search by the number of moves of a turn, a couple of hundred on the
+    standard board. Mirrored positions are searched and stored once unless
+    --symmetry is 0.
+
+    The result is written as a hash table that the engine maps straight
+    into memory, see book.hpp. isola --book <file> plays from it.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "book.hpp"
+#include "game_state.hpp"
+#include "notation.hpp"
+#include "search.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+  isola::BoardSize size{isola::DefaultGeometry::ROWS,
+                        isola::DefaultGeometry::COLS};
+  const char *out = "opening.book";
+  int plies = 3;
+  isola::SearchLimits limits{.moveTime = std::chrono::milliseconds{0},
+                             .maxDepth = 8};
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t hashMB = 64;
+  bool symmetry = true;
+};
+
+template <class G> class BookBuilder {
+  using GameState = isola::BasicGameState<G>;
+  using MoveList = isola::BasicMoveList<G>;
+
+  const Config &m_config;
+  isola::BasicEngine<G> m_engine;
+  unsigned m_symmetries;
+  // Keyed by canonical key, positions reached by transposition, mirrored
+  // lines or in both sides' books are searched once
+  std::unordered_map<std::uint64_t, isola::BookEntry> m_entries;
+  Clock::time_point m_start = Clock::now();
+
+public:
+  explicit BookBuilder(const Config &config)
+      : m_config(config),
+        m_symmetries(config.symmetry ? isola::positionSymmetries(GameState())
+                                     : 0) {
+    m_engine.setHashSize(config.hashMB);
+  }
+
+  void build() {
+    for (int side = 0; side < 2; ++side) {
+      GameState state;
+      expand(state, 0, side);
+    }
+  }
+
+  unsigned symmetries() const { return m_symmetries; }
+
+  std::vector<isola::BookEntry> entries() const {
+    std::vector<isola::BookEntry> entries;
+    entries.reserve(m_entries.size());
+    for (const auto &[key, entry] : m_entries) {
+      entries.push_back(entry);
+    }
+    return entries;
+  }
+
+private:
+  void expand(GameState &state, int ply, int side) {
+    if (ply >= m_config.plies || state.isGameOver()) {
+      return;
+    }
+
+    if (state.sideToMove() == side) {
+      isola::Move best = bookMove(state);
+      state.makeMove(best);
+      expand(state, ply + 1, side);
+      state.unmakeMove(best);
+      return;
+    }
+
+    MoveList moves;
+    state.generateMoves(moves);
+    for (isola::Move move : moves) {
+      state.makeMove(move);
+      expand(state, ply + 1, side);
+      state.unmakeMove(move);
+    }
+  }
+
+  isola::Move bookMove(const GameState &state) {
+    isola::CanonicalKey key = isola::canonicalKey(state, m_symmetries);
+    auto found = m_entries.find(key.key);
+    if (found != m_entries.end()) {
+      return isola::untransformMove<G>(key.symmetry, found->second.move());
+    }
+
+    isola::SearchResult result =
+        m_engine.search(state, m_config.limits, m_config.threads);
+    m_entries.emplace(
+        key.key, isola::makeBookEntry(
+                     key.key,
+                     isola::transformMove<G>(key.symmetry, result.bestMove),
+                     result.score, result.depth));
+
+    char move[isola::MOVE_TEXT_SIZE];
+    *isola::formatMove<G>(result.bestMove, move) = '\0';
+    std::fprintf(stderr, "%6zu positions %8.1f s  depth %2d score %6d  %s\n",
+                 m_entries.size(),
+                 std::chrono::duration<double>(Clock::now() - m_start).count(),
+                 result.depth, result.score, move);
+    return result.bestMove;
+  }
+};
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg{argv[i]};
+    const char *value = argv[i + 1];
+
+    if (arg == "--out") {
+      config.out = value;
+    } else if (arg == "--plies") {
+      config.plies = std::atoi(value);
+    } else if (arg == "--depth") {
+      config.limits.maxDepth = std::atoi(value);
+    } else if (arg == "--movetime") {
+      config.limits.moveTime = std::chrono::milliseconds{std::atoi(value)};
+      config.limits.maxDepth = isola::MAX_PLY;
+    } else if (arg == "--threads") {
+      config.threads = std::max(1, std::atoi(value));
+    } else if (arg == "--hash") {
+      config.hashMB = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--size") {
+      auto size = isola::parseBoardSize(value);
+      if (!size) {
+        return false;
+      }
+      config.size = *size;
+    } else if (arg == "--symmetry") {
+      config.symmetry = std::atoi(value) != 0;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+template <class G> int run(const Config &config) {
+  BookBuilder<G> builder(config);
+  builder.build();
+
+  std::vector<isola::BookEntry> entries = builder.entries();
+  if (!isola::writeBook<G>(config.out, entries, builder.symmetries())) {
+    std::perror(config.out);
+    return EXIT_FAILURE;
+  }
+  std::fprintf(stderr, "%zu positions written to %s\n", entries.size(),
+               config.out);
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr,
+                 "Usage: %s [--out <file>] [--plies <n>] [--depth <n>]\n"
+                 "       [--movetime <ms>] [--threads <n>] [--hash <mb>]\n"
+                 "       [--size <rows>x<cols>] [--symmetry 0|1]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_FAILURE;
+  if (!isola::dispatchGeometry(config.size,
+                               [&]<class G>() { status = run<G>(config); })) {
+    std::fprintf(stderr, "%dx%d boards are not supported\n", config.size.rows,
+                 config.size.cols);
+  }
+  return status;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Opening book.
+
+    The first turns from the start position are the same in every game and
+    the most expensive to search, so isola_book searches them deeply once and
+    writes the results to a file the engine looks positions up in before it
+    searches:
+
+        header    magic "ISBK", version, rows, cols, symmetries the keys
+                  are canonical under, hash of the start position, table
+                  capacity, entry count
+        entries   an open addressing hash table of `capacity` BookEntry
+                  slots, a power of two, at most half of them used
+
+    A position lives in slot (hash & (capacity - 1)) or the first free slot
+    after it, and an empty slot has key zero. The table is written exactly
+    as it is probed, so loading a book is a single mmap with no parsing and
+    a lookup touches one or two cache lines.
+
+    Books are normally keyed like the transposition table while it searches
+    the start position (see symmetry.hpp): each pair of mirrored positions
+    is stored once, with the move for the image the canonical key belongs
+    to, and probe() mirrors it back.
+
+    Unlike game records the file is in the byte order of the machine that
+    built it. The hash of the start position in the header doubles as a
+    check of that and of the Zobrist keys, a book from a machine or a build
+    that hashes differently is refused instead of giving wrong moves.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+#include "mapped_file.hpp"
+#include "symmetry.hpp"
+
+namespace isola {
+
+constexpr std::uint8_t BOOK_VERSION = 1;
+
+struct BookEntry {
+  std::uint64_t key = 0;
+  std::int16_t score = 0;
+  std::uint8_t depth = 0;
+  std::int8_t from = NO_SQUARE;
+  std::int8_t to = NO_SQUARE;
+  std::int8_t arrow = NO_SQUARE;
+  std::uint8_t reserved[2] = {};
+
+  Move move() const { return {.from = from, .to = to, .arrow = arrow}; }
+};
+
+static_assert(sizeof(BookEntry) == 16);
+
+struct BookHeader {
+  char magic[4] = {'I', 'S', 'B', 'K'};
+  std::uint8_t version = BOOK_VERSION;
+  std::uint8_t rows = 0;
+  std::uint8_t cols = 0;
+  // positionSymmetries() mask, zero for plain hash keys
+  std::uint8_t symmetries = 0;
+  std::uint64_t startKey = 0;
+  std::uint64_t capacity = 0;
+  std::uint64_t count = 0;
+
+  template <class G> static BookHeader forGeometry() {
+    BookHeader header;
+    header.rows = G::ROWS;
+    header.cols = G::COLS;
+    header.startKey = BasicGameState<G>().hash();
+    return header;
+  }
+};
+
+static_assert(sizeof(BookHeader) == 32 &&
+                  sizeof(BookHeader) % alignof(BookEntry) == 0,
+              "entries are read in place right after the header");
+
+inline BookEntry makeBookEntry(std::uint64_t key, Move move, Score score,
+                               int depth) {
+  BookEntry entry;
+  entry.key = key;
+  entry.score = static_cast<std::int16_t>(score);
+  entry.depth = static_cast<std::uint8_t>(depth);
+  entry.from = move.from;
+  entry.to = move.to;
+  entry.arrow = move.arrow;
+  return entry;
+}
+
+// Lays `entries` out as a book file for G, keyed with canonicalKey() under
+// `symmetries`. Entries with a duplicate key keep the first one
+template <class G>
+bool writeBook(const char *path, const std::vector<BookEntry> &entries,
+               unsigned symmetries = 0) {
+  BookHeader header = BookHeader::forGeometry<G>();
+  header.symmetries = static_cast<std::uint8_t>(symmetries);
+  header.capacity =
+      std::bit_ceil(std::max<std::size_t>(2 * entries.size(), 2));
+
+  std::vector<BookEntry> table(header.capacity);
+  std::uint64_t mask = header.capacity - 1;
+  for (const BookEntry &entry : entries) {
+    // Zero marks an empty slot
+    if (entry.key == 0) {
+      continue;
+    }
+    std::uint64_t i = entry.key & mask;
+    while (table[i].key != 0 && table[i].key != entry.key) {
+      i = (i + 1) & mask;
+    }
+    if (table[i].key == 0) {
+      table[i] = entry;
+      ++header.count;
+    }
+  }
+
+  std::FILE *file = std::fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(table.data(), sizeof(BookEntry), table.size(),
+                        file) == table.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+// A read-only mapping of a book file
+template <class G> class OpeningBook {
+  MappedFile m_file;
+
+  explicit OpeningBook(MappedFile file) : m_file(std::move(file)) {}
+
+  const BookEntry *table() const {
+    return reinterpret_cast<const BookEntry *>(m_file.data() +
+                                               sizeof(BookHeader));
+  }
+
+public:
+  // Nothing when the file can't be mapped, is truncated or was built for
+  // another board, byte order or set of hash keys
+  static std::optional<OpeningBook> open(const char *path) {
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file || file->size() < sizeof(BookHeader)) {
+      return std::nullopt;
+    }
+
+    OpeningBook book(std::move(*file));
+    const BookHeader &header = book.header();
+    BookHeader expected = BookHeader::forGeometry<G>();
+    if (std::memcmp(header.magic, expected.magic, 4) != 0 ||
+        header.version != expected.version || header.rows != expected.rows ||
+        header.cols != expected.cols ||
+        header.symmetries >= 1u << SYMMETRIES<G> ||
+        header.startKey != expected.startKey ||
+        !std::has_single_bit(header.capacity) ||
+        header.count > header.capacity / 2 ||
+        (book.m_file.size() - sizeof(BookHeader)) / sizeof(BookEntry) <
+            header.capacity) {
+      return std::nullopt;
+    }
+    book.m_file.advise(MADV_RANDOM);
+    return book;
+  }
+
+  const BookHeader &header() const {
+    return *reinterpret_cast<const BookHeader *>(m_file.data());
+  }
+
+  // Positions in the book
+  std::size_t size() const { return header().count; }
+
+  // Fills entry and returns true when the position is in the book. The move
+  // can still be wrong for a position whose hash collides with a book
+  // position, callers check it is legal before playing it
+  bool probe(const BasicGameState<G> &state, BookEntry &entry) const {
+    CanonicalKey key = canonicalKey(state, header().symmetries);
+    std::uint64_t mask = header().capacity - 1;
+    const BookEntry *slots = table();
+    for (std::uint64_t i = key.key & mask; slots[i].key != 0;
+         i = (i + 1) & mask) {
+      if (slots[i].key == key.key) {
+        entry = slots[i];
+        Move move = untransformMove<G>(key.symmetry, entry.move());
+        entry.from = move.from;
+        entry.to = move.to;
+        entry.arrow = move.arrow;
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+} // namespace isola
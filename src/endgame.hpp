@@ -0,0 +1,250 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Exact play once the players are walled off from each other.
+
+    When no free square can be reached by both players the game splits into
+    two independent races. Every player can only ever step inside its own
+    region, and an arrow only ever matters in the opponent's region (an arrow
+    into your own region can never help you). So each region is a small game
+    between a walker, who wants to make as many steps as possible, and the
+    other player, who deletes one of its squares with every arrow:
+        - the side to move steps first in its own region, the opponent's arrow
+          comes after each step
+        - in the opponent's region the side to move's arrow lands before the
+          opponent's first step
+    With S the number of steps each player gets, the side to move wins exactly
+    when S(side to move) > S(opponent). Without arrows S would just be the
+    longest walk through the region; WalkSolver plays the deletions out too,
+    memoized on (square, region mask), which is exact and still cheap for the
+    small regions left at the end of a game. With a tablebase (see
+    tablebase.hpp) every region that fits in its window, including the ones
+    the recursion reaches, is a lookup instead.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "bitboard.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+#include "tablebase.hpp"
+
+namespace isola {
+
+// Free squares reachable from `from` through `free` by king moves, `from`
+// itself is not included
+template <class G>
+constexpr typename G::Bitboard floodFill(Square from,
+                                         typename G::Bitboard free) {
+  typename G::Bitboard reached = G::neighbors(from) & free;
+  for (;;) {
+    typename G::Bitboard next = G::dilate(reached) & free;
+    if (next == reached) {
+      return reached;
+    }
+    reached = next;
+  }
+}
+
+template <class G> struct Partition {
+  bool separated = false;
+  // Squares each player can still reach, only filled in when separated
+  typename G::Bitboard regions[2] = {0, 0};
+};
+
+// The players share a region exactly when the first player's flood fill
+// reaches a free neighbour of the second one. While the players are still in
+// contact that usually happens after a couple of dilations, so the common case
+// stops early and never fills the second region
+template <class G> Partition<G> findPartition(const BasicGameState<G> &state) {
+  using Bitboard = typename G::Bitboard;
+
+  Bitboard free = state.free();
+  Bitboard contact = G::neighbors(state.player(1)) & free;
+
+  Bitboard reached = G::neighbors(state.player(0)) & free;
+  for (;;) {
+    if (reached & contact) {
+      return {};
+    }
+    Bitboard next = G::dilate(reached) & free;
+    if (next == reached) {
+      break;
+    }
+    reached = next;
+  }
+  return {.separated = true,
+          .regions = {reached, floodFill<G>(state.player(1), free)}};
+}
+
+template <class G> class WalkSolver {
+  using Bitboard = typename G::Bitboard;
+
+  // On boards up to 49 squares each memo entry is one word: the region mask
+  // in bits 0-48, the steps in bits 49-55, the square in bits 56-61 and
+  // whether the deleter is to move in bit 63. The key is the word without the
+  // steps, so it is exact and never collides. Bigger boards keep the region
+  // in a word of its own and the rest of the key next to it
+  static constexpr bool PACKED = G::SQUARES <= 49;
+
+  static constexpr int STEPS_SHIFT = 49;
+  static constexpr std::uint64_t STEPS_MASK = std::uint64_t{0x7f}
+                                              << STEPS_SHIFT;
+  // Bit 62 is never part of a key
+  static constexpr std::uint64_t EMPTY_ENTRY = ~std::uint64_t{0};
+
+  struct WideEntry {
+    // Never empty for a stored entry
+    Bitboard region;
+    // The square in bits 0-6, the deleter to move in bit 7, the steps above
+    std::uint32_t rest;
+  };
+
+  using Entry = std::conditional_t<PACKED, std::uint64_t, WideEntry>;
+
+  std::unique_ptr<Entry[]> m_entries;
+  std::size_t m_mask;
+  const Tablebase *m_tablebase = nullptr;
+
+public:
+  static constexpr int DEFAULT_SIZE_LOG2 = 17;
+
+  explicit WalkSolver(int sizeLog2 = DEFAULT_SIZE_LOG2)
+      : m_entries(new Entry[std::size_t{1} << sizeLog2]),
+        m_mask((std::size_t{1} << sizeLog2) - 1) {
+    clear();
+  }
+
+  void clear() {
+    if constexpr (PACKED) {
+      std::fill(m_entries.get(), m_entries.get() + m_mask + 1, EMPTY_ENTRY);
+    } else {
+      std::fill(m_entries.get(), m_entries.get() + m_mask + 1,
+                WideEntry{0, 0});
+    }
+  }
+
+  // The tablebase has to outlive the solver's use of it, nullptr turns it off
+  void setTablebase(const Tablebase *tablebase) { m_tablebase = tablebase; }
+
+  // Whether a region is a tablebase lookup rather than a search
+  bool inTablebase(Square from, Bitboard region) const {
+    return m_tablebase && m_tablebase->covers<G>(from, region);
+  }
+
+  // Longest walk from `from` through `region` when the walker moves first and
+  // an opponent arrow deletes one square of the region after every step
+  int walk(Square from, Bitboard region) {
+    return solve(from, floodFill<G>(from, region), false);
+  }
+
+  // Same, but the opponent's arrow lands before the first step
+  int walkAfterArrow(Square from, Bitboard region) {
+    return solve(from, floodFill<G>(from, region), true);
+  }
+
+  // Exact score of a separated position for the side to move, `ply` is the
+  // distance from the root used to prefer faster wins
+  Score score(const BasicGameState<G> &state, const Partition<G> &partition,
+              int ply) {
+    int us = state.sideToMove();
+    int ours = walk(state.player(us), partition.regions[us]);
+    int theirs =
+        walkAfterArrow(state.player(us ^ 1), partition.regions[us ^ 1]);
+
+    // We lose on our turn after `ours` steps if they are still going by then,
+    // otherwise they lose on their turn after `theirs` steps
+    if (ours <= theirs) {
+      return -(SCORE_WIN - (ply + 2 * ours));
+    }
+    return SCORE_WIN - (ply + 2 * theirs + 1);
+  }
+
+private:
+  // `region` is always the part of the board still reachable from `from`
+  int solve(Square from, Bitboard region, bool deleterToMove) {
+    if (!region) {
+      return 0;
+    }
+    // A single square is one last step whoever is to move, unless the arrow
+    // takes it first
+    if ((region & (region - 1)) == 0) {
+      return deleterToMove ? 0 : 1;
+    }
+
+    Entry *entry;
+    if constexpr (PACKED) {
+      std::uint64_t key = static_cast<std::uint64_t>(region) |
+                          std::uint64_t(from) << 56 |
+                          std::uint64_t(deleterToMove) << 63;
+      entry = &m_entries[mix(key) & m_mask];
+      if ((*entry & ~STEPS_MASK) == key) {
+        return static_cast<int>((*entry & STEPS_MASK) >> STEPS_SHIFT);
+      }
+    } else {
+      std::uint32_t key = std::uint32_t(from) | std::uint32_t(deleterToMove)
+                                                    << 7;
+      std::uint64_t folded = static_cast<std::uint64_t>(region) ^ key;
+      if constexpr (sizeof(Bitboard) > sizeof(std::uint64_t)) {
+        folded ^= mix(static_cast<std::uint64_t>(region >> 64));
+      }
+      entry = &m_entries[mix(folded) & m_mask];
+      if (entry->region == region && (entry->rest & 0xff) == key) {
+        return static_cast<int>(entry->rest >> 8);
+      }
+    }
+
+    int best;
+    if (m_tablebase &&
+        m_tablebase->probe<G>(from, region, deleterToMove, best)) {
+      // Memoized like a searched result, the memo is cheaper than a probe
+    } else if (deleterToMove) {
+      // An arrow that cuts squares off leaves only the reachable part
+      best = popCount(region);
+      for (Bitboard arrows = region; arrows && best > 0;) {
+        Square arrow = popLowest(arrows);
+        Bitboard left = region & ~G::squareBit(arrow);
+        best = std::min(best, solve(from, floodFill<G>(from, left), false));
+      }
+    } else {
+      best = 0;
+      int upperBound = popCount(region);
+      for (Bitboard steps = G::neighbors(from) & region;
+           steps && best < upperBound;) {
+        Square to = popLowest(steps);
+        Bitboard left = region & ~G::squareBit(to);
+        best = std::max(best, 1 + solve(to, floodFill<G>(to, left), true));
+      }
+    }
+
+    // The recursion may have written to the same slot, so the entry is filled
+    // in from scratch
+    if constexpr (PACKED) {
+      *entry = static_cast<std::uint64_t>(region) | std::uint64_t(from) << 56 |
+               std::uint64_t(deleterToMove) << 63 |
+               std::uint64_t(best) << STEPS_SHIFT;
+    } else {
+      *entry = {region, std::uint32_t(from) |
+                            std::uint32_t(deleterToMove) << 7 |
+                            std::uint32_t(best) << 8};
+    }
+    return best;
+  }
+
+  static std::uint64_t mix(std::uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccd;
+    key ^= key >> 33;
+    return key;
+  }
+};
+
+} // namespace isola
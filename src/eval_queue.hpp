@@ -0,0 +1,197 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Batched evaluation of leaf positions for the Monte Carlo search.
+
+    Searches hand the leaves they want scored to an EvalQueue and carry on
+    with other work. Every queued EvalRequest is the caller's own: once its
+    value is filled in its ready flag is set with a release store, so
+    polling it is a single load and nothing is allocated per position. A
+    queue isn't tied to a search or an engine. Every thread of every engine
+    that is given the same queue, for instance every game of a match, adds
+    to the same batches.
+
+    There is no thread of its own scoring the batches, they are scored by
+    the threads that queue them: the request that fills a batch has it
+    scored before submit returns, and a thread that has nothing left to do
+    but wait calls dispatch and scores whatever is waiting, whoever queued
+    it. So nobody sleeps while there are positions to score, nothing is
+    handed from thread to thread, and batches grow with the number of
+    requests kept in flight.
+
+    A backend turns positions into win probabilities for their side to
+    move. Two run on the CPU:
+        network     the evaluation network (nnue.hpp), int16 SIMD within
+                    each position
+        reach       evaluateBatch of batch_eval.hpp, SIMD across positions
+    Anything that scores a whole batch at once, ONNX Runtime or a CUDA
+    kernel, is one more EvalBackend; none of them is linked in here.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "batch_eval.hpp"
+#include "game_state.hpp"
+#include "nnue.hpp"
+
+namespace isola {
+
+// Most positions the dispatcher hands the backend at once
+constexpr std::size_t DEFAULT_EVAL_BATCH = 256;
+
+// Called from every thread using the queue, possibly at once
+template <class G> class EvalBackend {
+public:
+  virtual ~EvalBackend() = default;
+
+  virtual const char *name() const = 0;
+  // values[i] is the probability that the side to move of states[i] wins
+  virtual void evaluate(const BasicGameState<G> *states, std::size_t count,
+                        float *values) = 0;
+};
+
+inline float winProbability(double logit) {
+  return static_cast<float>(1.0 / (1.0 + std::exp(-logit)));
+}
+
+template <class G> class NetworkBackend : public EvalBackend<G> {
+  const BasicNetwork<G> &m_network;
+
+public:
+  // The network has to outlive the backend
+  explicit NetworkBackend(const BasicNetwork<G> &network)
+      : m_network(network) {}
+
+  const char *name() const override { return "network"; }
+
+  void evaluate(const BasicGameState<G> *states, std::size_t count,
+                float *values) override {
+    for (std::size_t i = 0; i < count; ++i) {
+      values[i] = winProbability(static_cast<double>(
+                                     m_network.evaluate(states[i])) /
+                                 NETWORK_SCORE_SCALE);
+    }
+  }
+};
+
+template <class G> class ReachBackend : public EvalBackend<G> {
+public:
+  // Points of evalReach per unit of the logit
+  static constexpr double SCALE = 3;
+
+  const char *name() const override { return "reach"; }
+
+  void evaluate(const BasicGameState<G> *states, std::size_t count,
+                float *values) override {
+    std::vector<int> scores(count);
+    evaluateBatch(states, count, scores.data());
+    for (std::size_t i = 0; i < count; ++i) {
+      values[i] = winProbability(scores[i] / SCALE);
+    }
+  }
+};
+
+// A position waiting for its value, owned by whoever queued it
+template <class G> struct EvalRequest {
+  BasicGameState<G> state;
+  float value = 0;
+  std::atomic<bool> ready{false};
+
+  bool isReady() const { return ready.load(std::memory_order_acquire); }
+};
+
+template <class G> class EvalQueue {
+  using Request = EvalRequest<G>;
+
+  EvalBackend<G> &m_backend;
+  std::size_t m_batchSize;
+
+  std::mutex m_mutex;
+  std::vector<Request *> m_waiting;
+
+  std::atomic<std::uint64_t> m_batches{0};
+  std::atomic<std::uint64_t> m_positions{0};
+
+public:
+  // The backend has to outlive the queue
+  explicit EvalQueue(EvalBackend<G> &backend,
+                     std::size_t batchSize = DEFAULT_EVAL_BATCH)
+      : m_backend(backend), m_batchSize(std::max<std::size_t>(batchSize, 1)) {
+    m_waiting.reserve(m_batchSize);
+  }
+
+  EvalQueue(const EvalQueue &) = delete;
+  EvalQueue &operator=(const EvalQueue &) = delete;
+
+  const EvalBackend<G> &backend() const { return m_backend; }
+
+  // Queues `request`, its state has to be set and it has to stay where it is
+  // until it is ready. Scores the batch right away when this fills it
+  void submit(Request &request) {
+    request.ready.store(false, std::memory_order_relaxed);
+    std::vector<Request *> batch;
+    {
+      std::lock_guard lock(m_mutex);
+      m_waiting.push_back(&request);
+      if (m_waiting.size() < m_batchSize) {
+        return;
+      }
+      batch.swap(m_waiting);
+      m_waiting.reserve(m_batchSize);
+    }
+    score(batch);
+  }
+
+  // Scores what is waiting on the calling thread, up to a batch, false when
+  // nothing was. For threads that have nothing else to do until their
+  // requests are ready
+  bool dispatch() {
+    std::vector<Request *> batch;
+    {
+      std::lock_guard lock(m_mutex);
+      if (m_waiting.empty()) {
+        return false;
+      }
+      batch.swap(m_waiting);
+      m_waiting.reserve(m_batchSize);
+    }
+    score(batch);
+    return true;
+  }
+
+  std::uint64_t batches() const {
+    return m_batches.load(std::memory_order_relaxed);
+  }
+  std::uint64_t positions() const {
+    return m_positions.load(std::memory_order_relaxed);
+  }
+
+private:
+  void score(const std::vector<Request *> &batch) {
+    std::vector<BasicGameState<G>> states;
+    states.reserve(batch.size());
+    for (const Request *request : batch) {
+      states.push_back(request->state);
+    }
+    std::vector<float> values(batch.size());
+    m_backend.evaluate(states.data(), states.size(), values.data());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      batch[i]->value = values[i];
+      batch[i]->ready.store(true, std::memory_order_release);
+    }
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    m_positions.fetch_add(batch.size(), std::memory_order_relaxed);
+  }
+};
+
+} // namespace isola
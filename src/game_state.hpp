@@ -0,0 +1,247 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Headless rules for Isola.
+
+    A Move is one whole turn of the side to move:
+        1. Stepping its piece to a neighbouring free square, killing the square it left
+        2. Shooting an arrow at any free square that is left
+    GameState only does bit twiddling on the position, it never allocates or
+    prints, so search and simulation code can drive it as fast as it likes.
+    Its Zobrist hash is kept up to date by every make / unmake call.
+    The interactive Isola game is just another client of it.
+
+    BasicGameState is instantiated per board Geometry (see bitboard.hpp),
+    GameState and MoveList are the standard 7 by 7 board.
+
+    clang-format on
+*/
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "bitboard.hpp"
+#include "board.hpp"
+#include "zobrist.hpp"
+
+namespace isola {
+
+struct Move {
+  std::int8_t from = NO_SQUARE;
+  std::int8_t to = NO_SQUARE;
+  // NO_SQUARE when the step left no free square to shoot at
+  std::int8_t arrow = NO_SQUARE;
+
+  friend constexpr bool operator==(const Move &, const Move &) = default;
+};
+
+constexpr Move NULL_MOVE{};
+
+// Up to 8 steps, each followed by an arrow at any square that is not dead, not
+// a player and not the square just vacated
+template <class G> constexpr std::size_t MAX_MOVES = 8 * (G::SQUARES - 3);
+
+// Every turn kills at least the square the player stepped away from
+template <class G> constexpr int MAX_GAME_TURNS = G::SQUARES - 2;
+
+template <class G> class BasicMoveList {
+  std::array<Move, MAX_MOVES<G>> m_moves;
+  std::size_t m_size = 0;
+
+public:
+  void push_back(Move move) {
+    assert(m_size < MAX_MOVES<G>);
+    m_moves[m_size++] = move;
+  }
+  void clear() { m_size = 0; }
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  Move &operator[](std::size_t i) { return m_moves[i]; }
+  const Move &operator[](std::size_t i) const { return m_moves[i]; }
+
+  Move *begin() { return m_moves.data(); }
+  Move *end() { return m_moves.data() + m_size; }
+  const Move *begin() const { return m_moves.data(); }
+  const Move *end() const { return m_moves.data() + m_size; }
+};
+
+template <class G> class BasicGameState {
+  using Bitboard = typename G::Bitboard;
+
+  Bitboard m_dead = 0;
+  Square m_players[2];
+  int m_side = 0;
+  std::uint64_t m_hash = 0;
+
+public:
+  using Geometry = G;
+
+  // Each player starts in the middle of the row closest to their side
+  BasicGameState()
+      : m_players{G::toSquare(0, G::COLS / 2),
+                  G::toSquare(G::ROWS - 1, G::COLS / 2)},
+        m_hash(computeHash()) {}
+
+  BasicGameState(const BasicBoard<G> &board, int sideToMove)
+      : m_dead(board.dead()), m_players{board.player(0), board.player(1)},
+        m_side(sideToMove) {
+    assert(m_players[0] != NO_SQUARE && m_players[1] != NO_SQUARE);
+    assert(sideToMove == 0 || sideToMove == 1);
+    m_hash = computeHash();
+  }
+
+  BasicBoard<G> toBoard() const {
+    BasicBoard<G> board;
+    for (Bitboard dead = m_dead; dead;) {
+      Square sq = popLowest(dead);
+      board.setCell(G::rowOf(sq), G::colOf(sq), DEAD_CELL);
+    }
+    board.setCell(G::rowOf(m_players[0]), G::colOf(m_players[0]),
+                  PLAYER_ONE);
+    board.setCell(G::rowOf(m_players[1]), G::colOf(m_players[1]),
+                  PLAYER_TWO);
+    return board;
+  }
+
+  int sideToMove() const { return m_side; }
+  std::uint64_t hash() const { return m_hash; }
+
+  // Where the fields sit, for kernels that load whole positions into vector
+  // registers instead of going through the accessors (see batch_eval.hpp)
+  static constexpr std::size_t deadOffset() {
+    return offsetof(BasicGameState, m_dead);
+  }
+  static constexpr std::size_t playersOffset() {
+    return offsetof(BasicGameState, m_players);
+  }
+  static constexpr std::size_t sideOffset() {
+    return offsetof(BasicGameState, m_side);
+  }
+
+  // Hash of the position built from scratch, hash() must always equal this
+  std::uint64_t computeHash() const {
+    std::uint64_t hash = m_side ? ZOBRIST<G>.side : 0;
+    for (Bitboard dead = m_dead; dead;) {
+      hash ^= ZOBRIST<G>.dead[popLowest(dead)];
+    }
+    hash ^= ZOBRIST<G>.player[0][m_players[0]];
+    hash ^= ZOBRIST<G>.player[1][m_players[1]];
+    return hash;
+  }
+
+  Square player(int index) const { return m_players[index]; }
+
+  Bitboard dead() const { return m_dead; }
+  Bitboard occupied() const {
+    return m_dead | G::squareBit(m_players[0]) | G::squareBit(m_players[1]);
+  }
+  Bitboard free() const { return G::BOARD_MASK & ~occupied(); }
+  bool isFree(Square sq) const { return (free() & G::squareBit(sq)) != 0; }
+
+  // Squares the side to move can step to
+  Bitboard stepTargets() const {
+    return G::neighbors(m_players[m_side]) & free();
+  }
+
+  // The side to move loses when it cannot step at the start of its turn
+  bool isGameOver() const { return stepTargets() == 0; }
+  int winner() const {
+    assert(isGameOver());
+    return m_side ^ 1;
+  }
+
+  bool isLegal(Move move) const {
+    if (move.from != m_players[m_side] || move.to < 0 ||
+        move.to >= G::SQUARES || !(stepTargets() & G::squareBit(move.to))) {
+      return false;
+    }
+
+    Bitboard arrows = free() & ~G::squareBit(move.to);
+    if (move.arrow == NO_SQUARE) {
+      return arrows == 0;
+    }
+    return move.arrow >= 0 && move.arrow < G::SQUARES &&
+           (arrows & G::squareBit(move.arrow));
+  }
+
+  void generateMoves(BasicMoveList<G> &moves) const {
+    moves.clear();
+
+    Square from = m_players[m_side];
+    for (Bitboard steps = stepTargets(); steps;) {
+      Square to = popLowest(steps);
+
+      // After the step `from` is dead and `to` is occupied
+      Bitboard arrows = free() & ~G::squareBit(to);
+      if (!arrows) {
+        moves.push_back({.from = static_cast<std::int8_t>(from),
+                         .to = static_cast<std::int8_t>(to),
+                         .arrow = NO_SQUARE});
+      }
+      while (arrows) {
+        moves.push_back({.from = static_cast<std::int8_t>(from),
+                         .to = static_cast<std::int8_t>(to),
+                         .arrow = static_cast<std::int8_t>(popLowest(arrows))});
+      }
+    }
+  }
+
+  // The two halves of a turn, the side to move only switches after the arrow
+  void makeStep(Square to) {
+    assert(stepTargets() & G::squareBit(to));
+    Square from = m_players[m_side];
+    m_hash ^= ZOBRIST<G>.dead[from] ^ ZOBRIST<G>.player[m_side][from] ^
+              ZOBRIST<G>.player[m_side][to];
+    m_dead |= G::squareBit(from);
+    m_players[m_side] = to;
+  }
+
+  void unmakeStep(Square from) {
+    Square to = m_players[m_side];
+    m_hash ^= ZOBRIST<G>.dead[from] ^ ZOBRIST<G>.player[m_side][from] ^
+              ZOBRIST<G>.player[m_side][to];
+    m_dead &= ~G::squareBit(from);
+    m_players[m_side] = from;
+  }
+
+  void makeArrow(Square sq) {
+    assert(sq == NO_SQUARE ? free() == 0 : isFree(sq));
+    if (sq != NO_SQUARE) {
+      m_dead |= G::squareBit(sq);
+      m_hash ^= ZOBRIST<G>.dead[sq];
+    }
+    m_side ^= 1;
+    m_hash ^= ZOBRIST<G>.side;
+  }
+
+  void unmakeArrow(Square sq) {
+    m_side ^= 1;
+    m_hash ^= ZOBRIST<G>.side;
+    if (sq != NO_SQUARE) {
+      m_dead &= ~G::squareBit(sq);
+      m_hash ^= ZOBRIST<G>.dead[sq];
+    }
+  }
+
+  void makeMove(Move move) {
+    assert(isLegal(move));
+    makeStep(move.to);
+    makeArrow(move.arrow);
+  }
+
+  void unmakeMove(Move move) {
+    unmakeArrow(move.arrow);
+    unmakeStep(move.from);
+  }
+};
+
+using MoveList = BasicMoveList<DefaultGeometry>;
+using GameState = BasicGameState<DefaultGeometry>;
+
+} // namespace isola
@@ -16,14 +16,33 @@
     clang-format on
 */
 
+#include <algorithm>
 #include <cassert>
 #include <charconv>
+#include <chrono>
+#include <cstddef>
 #include <cstdio>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <system_error>
-#include <vector>
+
+#include "bitboard.hpp"
+#include "board.hpp"
+#include "book.hpp"
+#include "eval_queue.hpp"
+#include "game_state.hpp"
+#include "mcts.hpp"
+#include "nnue.hpp"
+#include "protocol.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
+#include "timeman.hpp"
 
 namespace isola {
 
@@ -49,72 +68,137 @@ struct Player {
   }
 };
 
-constexpr const char *EMPTY_SPOT = "+";
+template <class G> class BasicIsola {
+  BasicGameState<G> state;
+  Player *activePlayer;
+  Player p1;
+  Player p2;
 
-class Board {
-    int m_rows;
-    int m_cols;
-    std::vector<std::vector<std::string>> m_board;
+  // Side played by the engine, -1 when both sides are human
+  int computerSide = -1;
+  int computerThreads = 1;
+  SearchLimits computerLimits;
+  // Replaces the fixed move time when set
+  std::optional<GameClock> computerClock;
+  BasicEngine<G> engine;
+  // Plays instead of engine when set
+  std::unique_ptr<BasicMctsEngine<G>> mcts;
+  std::optional<OpeningBook<G>> book;
+  std::optional<Tablebase> tablebase;
+  std::optional<BasicNetwork<G>> network;
+  // Score the MCTS leaves with the network when both are in use
+  std::unique_ptr<EvalBackend<G>> evalBackend;
+  std::unique_ptr<EvalQueue<G>> evalQueue;
+  // Think on the human's time about the reply the engine expects
+  bool ponder = false;
+  Move expectedReply = NULL_MOVE;
+  std::future<void> pondering;
+#ifdef _WIN32
+  bool ansiRedraw = false;
+#else
+  bool ansiRedraw = true;
+#endif
 
 public:
-  Board(int rows, int cols)
-      : m_rows(rows), m_cols(cols),
-        m_board(rows, std::vector<std::string>(cols, EMPTY_SPOT)) {}
+  BasicIsola()
+      : activePlayer(nullptr),
+        p1{.avitar = PLAYER_ONE,
+           .row = G::rowOf(state.player(0)),
+           .col = G::colOf(state.player(0))},
+        p2{.avitar = PLAYER_TWO,
+           .row = G::rowOf(state.player(1)),
+           .col = G::colOf(state.player(1))} {
+    activePlayer = &p1;
+  }
 
-  void setCell(int row, int col, const std::string &symbol) {
-    m_board[row][col] = symbol;
+  // Let the engine play `side` (0 for B, 1 for W), thinking for up to
+  // `moveTime` per turn
+  void setComputerPlayer(int side, std::chrono::milliseconds moveTime) {
+    assert(side == 0 || side == 1);
+    computerSide = side;
+    computerLimits.moveTime = moveTime;
   }
 
-  const std::string &getCell(int row, int col) const {
-    return m_board[row][col];
+  // Give the engine `time` for the whole game instead, plus `increment` for
+  // every move it makes
+  void setComputerClock(std::chrono::milliseconds time,
+                        std::chrono::milliseconds increment) {
+    computerClock = GameClock{.remaining = time, .increment = increment};
   }
 
-  std::string toString() const {
-    std::string str;
-    for (int row = 0; row < rows(); ++row) {
-      for (int col = 0; col < cols(); ++col) {
-        str += m_board[row][col];
-      }
-      str += "\n";
-    }
-    return str;
+  void setHashSize(std::size_t megabytes) { engine.setHashSize(megabytes); }
+  void setThreads(int threads) { computerThreads = threads; }
+  void useMcts() {
+    mcts = std::make_unique<BasicMctsEngine<G>>();
+    connectEvalQueue();
   }
-  std::string toPrettyString() {
-    std::string str = "  "; // reserve space for row labels
-    for (int col = 0; col < cols(); ++col) {
-      str += std::to_string(col + 1);
+  void setPonder(bool enabled) { ponder = enabled; }
+  // Clear the screen with ANSI escapes written along with each frame, or by
+  // running the system's clear command
+  void setAnsiRedraw(bool ansi) { ansiRedraw = ansi; }
+
+  // The engine plays the opening from the book at `path` as long as the game
+  // stays in it, false when the file isn't a book for this board
+  bool loadBook(const char *path) {
+    engine.setBook(nullptr);
+    book = OpeningBook<G>::open(path);
+    if (!book) {
+      return false;
     }
-    str += "\n";
+    engine.setBook(&*book);
+    return true;
+  }
 
-    for (int row = 0; row < rows(); ++row) {
-      str += std::to_string(row + 1) + " ";
-      for (int col = 0; col < cols(); ++col) {
-        str += m_board[row][col];
-      }
-      str += "\n";
+  // The engine solves endgames with the tablebase at `path`, false when the
+  // file isn't a tablebase
+  bool loadTablebase(const char *path) {
+    engine.setTablebase(nullptr);
+    tablebase = Tablebase::open(path);
+    if (!tablebase) {
+      return false;
     }
-    return str;
+    engine.setTablebase(&*tablebase);
+    return true;
   }
 
-  int rows() const { return m_rows; }
-  int cols() const { return m_rows; }
-};
-
-constexpr const char *DEAD_CELL = "A";
+  // The engine evaluates with the network at `path`, false when the file
+  // isn't a network for this board
+  bool loadNetwork(const char *path) {
+    engine.setNetwork(nullptr);
+    // The queue scores with the network that is about to go
+    network.reset();
+    connectEvalQueue();
+    network = BasicNetwork<G>::open(path);
+    if (!network) {
+      return false;
+    }
+    engine.setNetwork(&*network);
+    connectEvalQueue();
+    return true;
+  }
 
-class Isola {
-  Player *activePlayer;
-  Player p1;
-  Player p2;
-  Board board;
+  // With both MCTS and a network the tree's leaves are scored by the
+  // network in batches instead of played out
+  void connectEvalQueue() {
+    if (mcts) {
+      mcts->setEvalQueue(nullptr);
+    }
+    evalQueue.reset();
+    evalBackend.reset();
+    if (mcts && network) {
+      evalBackend = std::make_unique<NetworkBackend<G>>(*network);
+      evalQueue = std::make_unique<EvalQueue<G>>(*evalBackend);
+      mcts->setEvalQueue(evalQueue.get());
+    }
+  }
 
-public:
-  Isola()
-      : activePlayer(nullptr), p1{.avitar = "B", .row = 0, .col = 3},
-        p2{.avitar = "W", .row = 6, .col = 3}, board(7, 7) {
-    activePlayer = &p1;
-    board.setCell(p1.row, p1.col, p1.avitar);
-    board.setCell(p2.row, p2.col, p2.avitar);
+  // Answers batch protocol commands instead of playing interactively, with
+  // the engine set up as for a computer player (see protocol.hpp). A go
+  // with no limits thinks for `moveTime`
+  void playProtocol(std::istream &in, std::ostream &out,
+                    std::chrono::milliseconds moveTime) {
+    BasicProtocol<G>(engine, mcts.get(), computerThreads, moveTime)
+        .run(in, out);
   }
 
   void play() {
@@ -130,8 +214,15 @@ public:
    */
 
     while (checkHasValidMove(activePlayer)) {
-      move(activePlayer);
-      fireArrow(activePlayer);
+      assert(state.sideToMove() == indexOf(activePlayer));
+      if (indexOf(activePlayer) == computerSide) {
+        computerTurn(activePlayer);
+      } else {
+        startPondering();
+        move(activePlayer);
+        fireArrow(activePlayer);
+        stopPondering();
+      }
       activePlayer = activePlayer == &p1 ? &p2 : &p1;
     }
 
@@ -213,15 +304,13 @@ public:
 
     bool isValidMove = true;
 
-    if (row < 0 || row > board.rows() - 1 || col < 0 ||
-        col > board.cols() - 1) {
+    if (!G::onBoard(row, col)) {
       isValidMove = false;
       std::cout << "Invalid move, please try again: " << std::endl;
-    } else if (board.getCell(row, col) == DEAD_CELL) {
+    } else if (state.dead() & G::squareBit(G::toSquare(row, col))) {
       isValidMove = false;
       std::cout << "That space is dead, please try again: " << std::endl;
-    } else if (board.getCell(row, col) == p1.avitar ||
-               board.getCell(row, col) == p2.avitar) {
+    } else if (!state.isFree(G::toSquare(row, col))) {
       isValidMove = false;
       std::cout << "That space is occupied by the opponent, please try again: "
                 << std::endl;
@@ -230,11 +319,9 @@ public:
       std::cout << "Valid move" << std::endl;
 
       // Kill the old location of the player
-      board.setCell(p->row, p->col, DEAD_CELL);
+      state.makeStep(G::toSquare(row, col));
       p->setCoordinates(row, col);
-      board.setCell(p->row, p->col, p->avitar);
 
-      clearTerm();
       drawBoard();
     }
 
@@ -244,6 +331,13 @@ public:
   void fireArrow(Player *p) {
     assert(p != nullptr);
 
+    // Stepping onto the last free space leaves nothing to shoot at
+    if (state.free() == 0) {
+      std::cout << "There is no space left to destroy." << std::endl;
+      state.makeArrow(NO_SQUARE);
+      return;
+    }
+
     std::cout << p->avitar << " time to fire an arrow!" << std::endl;
 
     int row;
@@ -263,11 +357,11 @@ public:
 
         row = in_row - 1;
 
-        if (ec != std::errc{} || row < 0 || row > board.rows() - 1) {
+        if (ec != std::errc{} || row < 0 || row > G::ROWS - 1) {
           std::cout << "Invalid coordinate!" << std::endl;
         }
 
-      } while (ec != std::errc{} || row < 0 || row > board.rows() - 1);
+      } while (ec != std::errc{} || row < 0 || row > G::ROWS - 1);
 
       do {
         std::cout << "Please select a column: ";
@@ -280,55 +374,126 @@ public:
 
         col = in_col - 1;
 
-        if (ec != std::errc{} || col < 0 || col > board.cols() - 1) {
+        if (ec != std::errc{} || col < 0 || col > G::COLS - 1) {
           std::cout << "Invalid coordinate!" << std::endl;
         }
-      } while (ec != std::errc{} || col < 0 || col > board.cols() - 1);
+      } while (ec != std::errc{} || col < 0 || col > G::COLS - 1);
 
-      if (board.getCell(row, col) != EMPTY_SPOT) {
+      if (!state.isFree(G::toSquare(row, col))) {
         std::cout << "That location cannot be destroyed." << std::endl;
       }
 
-    } while (board.getCell(row, col) != EMPTY_SPOT);
+    } while (!state.isFree(G::toSquare(row, col)));
 
-    board.setCell(row, col, DEAD_CELL);
-    clearTerm();
+    state.makeArrow(G::toSquare(row, col));
     drawBoard();
   }
 
-  bool checkHasValidMove(Player *p) {
+  void computerTurn(Player *p) {
     assert(p != nullptr);
 
-    bool hasValidMove = false;
-    int row = p->row;
-    int col = p->col;
+    std::cout << p->avitar << " is thinking..." << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    SearchLimits limits = computerClock
+                              ? allocateTime(state, *computerClock)
+                              : computerLimits;
+    SearchResult result = mcts ? mcts->search(state, limits, computerThreads)
+                               : engine.search(state, limits, computerThreads);
+    Move m = result.bestMove;
+    expectedReply = result.ponderMove;
+    if (computerClock) {
+      auto used = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start);
+      computerClock->remaining =
+          std::max(computerClock->remaining - used,
+                   std::chrono::milliseconds{0}) +
+          computerClock->increment;
+    }
 
-    // Check to see if there is an open spot around the player
-    if (row - 1 >= 0 && col - 1 >= 0 &&
-        board.getCell(row - 1, col - 1) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (row - 1 >= 0 && board.getCell(row - 1, col) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (row - 1 >= 0 && col + 1 < board.cols() &&
-               board.getCell(row - 1, col + 1) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (col - 1 >= 0 && board.getCell(row, col - 1) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (col + 1 < board.cols() &&
-               board.getCell(row, col + 1) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (row + 1 < board.rows() && col - 1 >= 0 &&
-               board.getCell(row + 1, col - 1) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (row + 1 < board.rows() &&
-               board.getCell(row + 1, col) == EMPTY_SPOT) {
-      hasValidMove = true;
-    } else if (row + 1 < board.rows() && col + 1 < board.cols() &&
-               board.getCell(row + 1, col + 1) == EMPTY_SPOT) {
-      hasValidMove = true;
+    state.makeMove(m);
+    p->setCoordinates(G::rowOf(m.to), G::colOf(m.to));
+
+    drawBoard();
+
+    std::cout << p->avitar << " moved to row " << G::rowOf(m.to) + 1
+              << ", column " << G::colOf(m.to) + 1;
+    if (m.arrow != NO_SQUARE) {
+      std::cout << " and destroyed row " << G::rowOf(m.arrow) + 1
+                << ", column " << G::colOf(m.arrow) + 1;
+    }
+    if (result.fromBook) {
+      std::cout << " (book)" << std::endl;
+      return;
+    }
+    std::cout << " (depth " << result.depth << ", " << result.nodes
+              << " nodes, " << static_cast<long long>(result.nodesPerSecond())
+              << " nodes/s on " << result.threads << " threads";
+    if (computerClock) {
+      std::cout << ", " << computerClock->remaining.count() << " ms left";
+    }
+    std::cout << ")" << std::endl;
+  }
+
+  // Searches the position after the reply the engine expects until the
+  // human has moved, or the human's position when it expects nothing. The
+  // engine's next search then starts from what this one left in the table,
+  // or with MCTS in the tree
+  void startPondering() {
+    if (!ponder || computerSide == -1) {
+      return;
+    }
+    BasicGameState<G> expected = state;
+    if (expected.isLegal(expectedReply)) {
+      expected.makeMove(expectedReply);
+    }
+    if (expected.isGameOver()) {
+      return;
     }
+    pondering = std::async(std::launch::async, [this, expected] {
+      SearchLimits limits;
+      limits.maxNodes = std::numeric_limits<std::uint64_t>::max();
+      if (mcts) {
+        mcts->search(expected, limits, computerThreads);
+      } else {
+        engine.search(expected, limits, computerThreads);
+      }
+    });
+  }
+
+  void stopPondering() {
+    if (!pondering.valid()) {
+      return;
+    }
+    // A stop that comes before the search has started is lost, so it is
+    // repeated until the search returns
+    while (pondering.wait_for(std::chrono::milliseconds{1}) !=
+           std::future_status::ready) {
+      if (mcts) {
+        mcts->stop();
+      } else {
+        engine.stop();
+      }
+    }
+    pondering.get();
+  }
+
+  bool checkHasValidMove(Player *p) {
+    assert(p != nullptr);
+
+    // Check to see if there is an open spot around the player
+    return G::hasMove(state.player(indexOf(p)), state.free());
+  }
+
+  // Number of open spots around the player
+  int mobilityOf(Player *p) {
+    assert(p != nullptr);
+
+    return G::mobility(state.player(indexOf(p)), state.free());
+  }
 
-    return hasValidMove;
+  int indexOf(const Player *p) const {
+    assert(p == &p1 || p == &p2);
+    return p == &p1 ? 0 : 1;
   }
 
   void displayRules() {
@@ -336,7 +501,7 @@ public:
     std::string str =
         "********** Isola Game **********"
         "\nEach player has one piece."
-        "\nThe Board has 7 by 7 positions, which initially contain"
+        "\nThe Board has " + std::to_string(G::ROWS) + " by " + std::to_string(G::COLS) + " positions, which initially contain"
         "\nfree spaces ('+') except for the initial positions"
         "\nof the players. A Move consists of two subsequent actions:"
         "\n\n1. Moving one's piece to a neighboring (horizontally, vertically,"
@@ -349,19 +514,35 @@ public:
     pause("Press any key to start...");
   }
 
-  void drawBoard() {
-    std::string str = board.toPrettyString();
+  // Cursor home, then erase the screen
+  static constexpr std::string_view ANSI_CLEAR = "\x1b[H\x1b[2J";
+  // In case the user doesn't have a num pad to look at...
+  static constexpr std::string_view NUMPAD = "\n7-8-9"
+                                             "\n4---6"
+                                             "\n1-2-3\n";
 
-    // In case the user doesn't have a num pad to look at...
-    str += "\n7-8-9"
-           "\n4---6"
-           "\n1-2-3\n";
+  // Builds the whole frame on the stack and writes it in one go
+  void drawBoard() {
+    char frame[ANSI_CLEAR.size() + BasicBoard<G>::PRETTY_TEXT_SIZE +
+               NUMPAD.size()];
+    char *next = frame;
+    if (ansiRedraw) {
+      next = std::copy(ANSI_CLEAR.begin(), ANSI_CLEAR.end(), next);
+    } else {
+      clearTerm();
+    }
+    next += state.toBoard().writePrettyString(
+        {next, static_cast<std::size_t>(std::end(frame) - next)});
+    next = std::copy(NUMPAD.begin(), NUMPAD.end(), next);
 
-    clearTerm();
-    std::cout << str << std::endl;
+    std::cout.write(frame, next - frame) << std::endl;
   }
 
   void clearTerm() {
+    if (ansiRedraw) {
+      std::cout << ANSI_CLEAR << std::flush;
+      return;
+    }
 #ifdef _WIN32
     system("cls");
 #else
@@ -375,4 +556,6 @@ public:
   }
 };
 
+using Isola = BasicIsola<DefaultGeometry>;
+
 } // namespace isola
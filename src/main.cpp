@@ -1,8 +1,128 @@
 #include "isola.hpp"
+#include "notation.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
 
 int main(int argc, char* argv[])
 {
-    isola::Isola board;
-    board.play();
+    // isola [--size <rows>x<cols>] [--computer B|W] [--movetime <ms>] [--hash <mb>]
+    //       [--threads <n>] [--mcts] [--book <file>] [--tablebase <file>]
+    //       [--network <file>]
+    //       [--time <ms> [--inc <ms>]] [--ponder] [--no-ansi] [--protocol]
+    isola::BoardSize size{isola::DefaultGeometry::ROWS, isola::DefaultGeometry::COLS};
+    int computerSide = -1;
+    std::chrono::milliseconds moveTime{1000};
+    // A clock for the whole game replaces the move time
+    std::chrono::milliseconds gameTime{0};
+    std::chrono::milliseconds increment{0};
+    std::size_t hashMB = 0; // zero keeps the engine's default
+    int threads = 1;
+    bool mcts = false;
+    // Think on the human's time too
+    bool ponder = false;
+    const char* bookPath = nullptr;
+    const char* tablebasePath = nullptr;
+    const char* networkPath = nullptr;
+    // Redraw with the clear command instead of ANSI escapes
+    bool noAnsi = false;
+    // Batch protocol on stdin / stdout instead of a game, see protocol.hpp
+    bool protocol = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if (arg == "--size" && i + 1 < argc) {
+            auto parsed = isola::parseBoardSize(argv[++i]);
+            if (!parsed) {
+                std::cerr << "Board sizes are written as <rows>x<cols>, like 7x7" << std::endl;
+                return EXIT_FAILURE;
+            }
+            size = *parsed;
+        } else if (arg == "--computer" && i + 1 < argc) {
+            computerSide = std::string_view{argv[++i]} == isola::PLAYER_ONE ? 0 : 1;
+        } else if (arg == "--movetime" && i + 1 < argc) {
+            moveTime = std::chrono::milliseconds{std::atoi(argv[++i])};
+        } else if (arg == "--time" && i + 1 < argc) {
+            gameTime = std::chrono::milliseconds{std::atoi(argv[++i])};
+        } else if (arg == "--inc" && i + 1 < argc) {
+            increment = std::chrono::milliseconds{std::atoi(argv[++i])};
+        } else if (arg == "--hash" && i + 1 < argc) {
+            hashMB = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--mcts") {
+            mcts = true;
+        } else if (arg == "--book" && i + 1 < argc) {
+            bookPath = argv[++i];
+        } else if (arg == "--tablebase" && i + 1 < argc) {
+            tablebasePath = argv[++i];
+        } else if (arg == "--ponder") {
+            ponder = true;
+        } else if (arg == "--network" && i + 1 < argc) {
+            networkPath = argv[++i];
+        } else if (arg == "--no-ansi") {
+            noAnsi = true;
+        } else if (arg == "--protocol") {
+            protocol = true;
+        }
+    }
+
+    // A file given on the command line that can't be used, and why
+    const char* unusable = nullptr;
+    const char* reason = nullptr;
+    bool supported = isola::dispatchGeometry(size, [&]<class G>()
+    {
+        isola::BasicIsola<G> board;
+        if (bookPath && !board.loadBook(bookPath)) {
+            unusable = bookPath;
+            reason = " is not an opening book for this board";
+            return;
+        }
+        if (tablebasePath && !board.loadTablebase(tablebasePath)) {
+            unusable = tablebasePath;
+            reason = " is not an endgame tablebase";
+            return;
+        }
+        if (networkPath && !board.loadNetwork(networkPath)) {
+            unusable = networkPath;
+            reason = " is not an evaluation network for this board";
+            return;
+        }
+        if (hashMB > 0) {
+            board.setHashSize(hashMB);
+        }
+        board.setThreads(threads);
+        if (noAnsi) {
+            board.setAnsiRedraw(false);
+        }
+        if (mcts) {
+            board.useMcts();
+        }
+        board.setPonder(ponder);
+        if (computerSide != -1) {
+            board.setComputerPlayer(computerSide, moveTime);
+            if (gameTime.count() > 0) {
+                board.setComputerClock(gameTime, increment);
+            }
+        }
+
+        if (protocol) {
+            // Lets the protocol see whether more input is already buffered
+            std::ios::sync_with_stdio(false);
+            board.playProtocol(std::cin, std::cout, moveTime);
+            return;
+        }
+        board.play();
+    });
+    if (!supported) {
+        std::cerr << size.rows << "x" << size.cols << " boards are not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (unusable) {
+        std::cerr << unusable << reason << std::endl;
+        return EXIT_FAILURE;
+    }
     return 0;
 }
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Read-only memory mapping of a whole file, shared by the file formats that
+    are used in place instead of being parsed (game records, opening books).
+
+    clang-format on
+*/
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace isola {
+
+class MappedFile {
+  const std::byte *m_data = nullptr;
+  std::size_t m_size = 0;
+
+  MappedFile(const std::byte *data, std::size_t size)
+      : m_data(data), m_size(size) {}
+
+public:
+  // Nothing when the file can't be opened, is empty or can't be mapped
+  static std::optional<MappedFile> open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return std::nullopt;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+      ::close(fd);
+      return std::nullopt;
+    }
+
+    std::size_t size = info.st_size;
+    void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is gone
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      return std::nullopt;
+    }
+    return MappedFile(static_cast<const std::byte *>(data), size);
+  }
+
+  MappedFile(MappedFile &&other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {}
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    return *this;
+  }
+
+  ~MappedFile() {
+    if (m_data) {
+      ::munmap(const_cast<std::byte *>(m_data), m_size);
+    }
+  }
+
+  const std::byte *data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+
+  // Tells the kernel how the mapping is going to be read, MADV_SEQUENTIAL or
+  // MADV_RANDOM
+  void advise(int advice) const {
+    ::madvise(const_cast<std::byte *>(m_data), m_size, advice);
+  }
+};
+
+} // namespace isola
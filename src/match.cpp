@@ -0,0 +1,674 @@
+/*
+    clang-format off
+
+    isola_match: plays two engine configurations against each other until a
+    sequential probability ratio test decides which one is stronger.
+
+        isola_match [--engine1 <spec>] [--engine2 <spec>] [--book <file>]
+                    [--opening-plies <n>] [--random-plies <n>]
+                    [--movetime <ms>] [--depth <n>] [--nodes <n>]
+                    [--threads <n>] [--pairs <n>] [--elo0 <elo>]
+                    [--elo1 <elo>] [--alpha <p>] [--beta <p>] [--seed <n>]
+                    [--report <pairs>] [--size <rows>x<cols>]
+
+    An engine spec is a comma separated list of settings, anything left out
+    is the engine's default:
+
+        mcts                        Monte Carlo tree search instead of
+                                    alpha-beta (only hash, reuse, batch,
+                                    in-flight, eval=reach and network apply)
+        eval=voronoi|mobility|reach the evaluation
+        hash=<mb>                   table size, or the MCTS node pool
+        arrows=near|all             restrictArrows of SearchOptions
+        radius=<n>                  arrowRadius
+        exhaustive=<n>              exhaustiveArrowsBelow
+        partitions=0|1              solvePartitions
+        partition-cells=<n>         partitionSolveCells
+        canonical=0|1               canonicalHashing
+        pvs=0|1                     pvs
+        aspiration=<depth>          aspirationDepth, 0 turns it off
+        window=<n>                  aspirationWindow
+        lmr=0|1                     lateMoveReductions
+        lmr-arrows=<n>              lateMoveArrows
+        reuse=0|1                   reuseTree of MctsOptions
+        tablebase=<file>            solve endgames with the tablebase
+        network=<file>              evaluate with the network
+        batch=<n>                   most MCTS leaves scored at once
+        in-flight=<n>               inFlight of MctsOptions
+
+    An MCTS engine with a network or eval=reach scores its leaves with it
+    instead of playing them out. Its leaves from every game go through one
+    evaluation queue per engine, so the batches are shared by all threads.
+
+    Games are played in pairs from the same opening, once with each engine
+    moving first, so an unbalanced opening favours neither. The openings are
+    the positions --opening-plies turns (default 2) in that are only reached
+    through positions the opening book has an entry for, in other words the
+    book's tree and one more turn, without mirrored duplicates and used in
+    turn.
+    Without --book each pair starts with --random-plies (default 2) random
+    turns instead, seeded per pair. Every move gets the same fixed budget,
+    --movetime 20 unless --depth or --nodes is given.
+
+    All --threads (default: every core) play games at once, each with its own
+    single threaded engines that are cleared before every game. After every
+    finished pair the test weighs H0, engine1 is elo0 (default 0) stronger,
+    against H1, it is elo1 (default 5) stronger, and it stops as soon as the
+    log likelihood ratio leaves the bounds given by --alpha and --beta (both
+    0.05 by default), or after --pairs (default 20000) pairs. Isola has no
+    draws, so a pair scores 0, 1 or 2 points for engine1 and the ratio is the
+    usual normal approximation over pair scores, which also accounts for how
+    much the two games of a pair agree. Half a pair of each outcome is added
+    before estimating the variance, so a run of identical pairs can't stop
+    the test by itself.
+
+    Prints a line every --report pairs (default 100) and the verdict at the
+    end. Exits with status 0 when H1 is accepted, 2 when H0 is and 3 when the
+    test ran out of pairs.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "batch_eval.hpp"
+#include "book.hpp"
+#include "eval.hpp"
+#include "eval_queue.hpp"
+#include "game_state.hpp"
+#include "mcts.hpp"
+#include "nnue.hpp"
+#include "notation.hpp"
+#include "search.hpp"
+#include "symmetry.hpp"
+#include "tablebase.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Eval { Voronoi, Mobility, Reach };
+
+struct EngineConfig {
+  std::string_view spec;
+  bool mcts = false;
+  Eval eval = Eval::Voronoi;
+  isola::SearchOptions options;
+  isola::MctsOptions mctsOptions;
+  std::size_t hashMB = 16;
+  // Empty when not used
+  std::string tablebase;
+  std::string network;
+  std::size_t batchSize = isola::DEFAULT_EVAL_BATCH;
+};
+
+struct Config {
+  isola::BoardSize size{isola::DefaultGeometry::ROWS,
+                        isola::DefaultGeometry::COLS};
+  EngineConfig engines[2];
+  const char *book = nullptr;
+  int openingPlies = 2;
+  int randomPlies = 2;
+  isola::SearchLimits limits{.moveTime = std::chrono::milliseconds{20}};
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::uint64_t pairs = 20000;
+  double elo0 = 0;
+  double elo1 = 5;
+  double alpha = 0.05;
+  double beta = 0.05;
+  std::uint64_t seed = 1;
+  std::uint64_t report = 100;
+};
+
+enum class Verdict { H1, H0, Undecided };
+
+// Expected score of the side that is `elo` stronger
+double expectedScore(double elo) {
+  return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+// The test over pair scores, not thread safe
+class Sprt {
+  // Pairs in which engine1 scored 0, 1 and 2 points
+  std::uint64_t m_counts[3] = {};
+  double m_lower;
+  double m_upper;
+  double m_score0;
+  double m_score1;
+
+public:
+  explicit Sprt(const Config &config)
+      : m_lower(std::log(config.beta / (1 - config.alpha))),
+        m_upper(std::log((1 - config.beta) / config.alpha)),
+        m_score0(expectedScore(config.elo0)),
+        m_score1(expectedScore(config.elo1)) {}
+
+  void add(int points) { ++m_counts[points]; }
+
+  std::uint64_t pairs() const {
+    return m_counts[0] + m_counts[1] + m_counts[2];
+  }
+  std::uint64_t count(int points) const { return m_counts[points]; }
+  double lower() const { return m_lower; }
+  double upper() const { return m_upper; }
+
+  // Engine1's share of the points
+  double score() const {
+    return pairs() > 0 ? (m_counts[1] * 0.5 + m_counts[2]) / pairs() : 0.5;
+  }
+
+  double llr() const {
+    double n = pairs();
+    if (n == 0) {
+      return 0;
+    }
+    // With half a pair of each outcome, see the top of the file
+    double regularized = n + 1.5;
+    double mean = (m_counts[1] * 0.5 + m_counts[2] + 0.75) / regularized;
+    double variance = ((m_counts[0] + 0.5) * mean * mean +
+                       (m_counts[1] + 0.5) * (0.5 - mean) * (0.5 - mean) +
+                       (m_counts[2] + 0.5) * (1 - mean) * (1 - mean)) /
+                      regularized;
+    return n * (m_score1 - m_score0) * (2 * score() - m_score0 - m_score1) /
+           (2 * variance);
+  }
+
+  // Elo difference and its 95% error margin, as far as the score allows
+  std::pair<double, double> elo() const {
+    double n = pairs();
+    double s = std::clamp(score(), 1e-3, 1 - 1e-3);
+    auto toElo = [](double s) { return -400 * std::log10(1 / s - 1); };
+    double variance = 0;
+    for (int points = 0; points < 3; ++points) {
+      double d = points * 0.5 - s;
+      variance += m_counts[points] * d * d;
+    }
+    double margin = n > 0 ? 1.96 * std::sqrt(variance / n / n) : 0;
+    return {toElo(s), (toElo(std::min(s + margin, 1 - 1e-3)) -
+                       toElo(std::max(s - margin, 1e-3))) /
+                          2};
+  }
+
+  Verdict verdict() const {
+    double ratio = llr();
+    return ratio >= m_upper   ? Verdict::H1
+           : ratio <= m_lower ? Verdict::H0
+                              : Verdict::Undecided;
+  }
+};
+
+// Openings from the book: every position `plies` turns in that is reached
+// through positions the book has an entry for, mirrored ones only once
+template <class G>
+std::vector<isola::BasicGameState<G>>
+bookOpenings(const isola::OpeningBook<G> &book, int plies) {
+  using GameState = isola::BasicGameState<G>;
+
+  GameState start;
+  unsigned symmetries = isola::positionSymmetries(start);
+  std::vector<GameState> openings;
+  std::unordered_set<std::uint64_t> seen;
+  isola::BookEntry entry;
+
+  auto visit = [&](auto &self, const GameState &state, int ply) -> void {
+    if (ply == plies) {
+      if (seen.insert(isola::canonicalKey(state, symmetries).key).second) {
+        openings.push_back(state);
+      }
+      return;
+    }
+    if (!book.probe(state, entry)) {
+      return;
+    }
+    isola::BasicMoveList<G> moves;
+    state.generateMoves(moves);
+    for (isola::Move move : moves) {
+      GameState next = state;
+      next.makeMove(move);
+      if (!next.isGameOver()) {
+        self(self, next, ply + 1);
+      }
+    }
+  };
+  visit(visit, start, 0);
+  return openings;
+}
+
+template <class G> isola::BasicEvaluator<G> evaluator(Eval eval) {
+  switch (eval) {
+  case Eval::Mobility:
+    return isola::evalMobility<G>;
+  case Eval::Reach:
+    return isola::evalReach<G>;
+  default:
+    return isola::evalVoronoi<G>;
+  }
+}
+
+// Shared by all threads, the results are only touched under the mutex
+template <class G> struct Match {
+  const Config &config;
+  std::vector<isola::BasicGameState<G>> openings;
+  std::optional<isola::Tablebase> tablebases[2];
+  std::optional<isola::BasicNetwork<G>> networks[2];
+  // Score the leaves of MCTS engines that evaluate them
+  std::unique_ptr<isola::EvalBackend<G>> backends[2];
+  std::unique_ptr<isola::EvalQueue<G>> queues[2];
+
+  std::atomic<std::uint64_t> nextGame{0};
+  std::atomic<bool> stop{false};
+  std::mutex mutex;
+  Sprt sprt;
+  // Points of engine1 in every game, -1 until it has been played
+  std::vector<std::int8_t> results;
+  std::uint64_t turns = 0;
+  std::uint64_t games = 0;
+  // Games won by the side that moved first
+  std::uint64_t firstMoverWins = 0;
+
+  explicit Match(const Config &config)
+      : config(config), sprt(config), results(2 * config.pairs, -1) {}
+
+  // The position the games of `pair` start from
+  isola::BasicGameState<G> opening(std::uint64_t pair) const {
+    if (!openings.empty()) {
+      return openings[pair % openings.size()];
+    }
+    std::mt19937_64 rng(config.seed ^ (pair * 0x9e3779b97f4a7c15));
+    isola::BasicGameState<G> state;
+    isola::BasicMoveList<G> moves;
+    for (int i = 0; i < config.randomPlies; ++i) {
+      state.generateMoves(moves);
+      if (moves.size() < 2) {
+        break;
+      }
+      state.makeMove(moves[rng() % moves.size()]);
+    }
+    return state;
+  }
+};
+
+// Prints the state of the test, the caller holds the match's mutex
+template <class G> void report(const Match<G> &match, Clock::duration time) {
+  const Sprt &sprt = match.sprt;
+  auto [elo, margin] = sprt.elo();
+  std::printf("pairs %6llu  2-0 %llu  1-1 %llu  0-2 %llu  score %.1f%%  "
+              "elo %+.1f +- %.1f  llr %+.2f [%.2f, %.2f]  %.0f s\n",
+              static_cast<unsigned long long>(sprt.pairs()),
+              static_cast<unsigned long long>(sprt.count(2)),
+              static_cast<unsigned long long>(sprt.count(1)),
+              static_cast<unsigned long long>(sprt.count(0)),
+              sprt.score() * 100, elo, margin, sprt.llr(), sprt.lower(),
+              sprt.upper(), std::chrono::duration<double>(time).count());
+  std::fflush(stdout);
+}
+
+// One thread's engines, playing game after game
+template <class G> class MatchWorker {
+  Match<G> &m_match;
+  Clock::time_point m_start;
+  std::unique_ptr<isola::BasicEngine<G>> m_engines[2];
+  std::unique_ptr<isola::BasicMctsEngine<G>> m_mcts[2];
+
+public:
+  MatchWorker(Match<G> &match, Clock::time_point start)
+      : m_match(match), m_start(start) {
+    for (int i = 0; i < 2; ++i) {
+      const EngineConfig &config = match.config.engines[i];
+      if (config.mcts) {
+        m_mcts[i] = std::make_unique<isola::BasicMctsEngine<G>>(
+            config.mctsOptions, config.hashMB);
+        m_mcts[i]->setEvalQueue(match.queues[i].get());
+        continue;
+      }
+      m_engines[i] = std::make_unique<isola::BasicEngine<G>>(
+          evaluator<G>(config.eval), config.options);
+      m_engines[i]->setHashSize(config.hashMB);
+      if (match.tablebases[i]) {
+        m_engines[i]->setTablebase(&*match.tablebases[i]);
+      }
+      if (match.networks[i]) {
+        m_engines[i]->setNetwork(&*match.networks[i]);
+      }
+    }
+  }
+
+  // Game 2k has engine1 moving first from opening k, game 2k + 1 engine2
+  void play(std::uint64_t game) {
+    int first = static_cast<int>(game % 2);
+    isola::BasicGameState<G> state = m_match.opening(game / 2);
+    // Which engine plays each side, the opening may end with either to move
+    int engineOf[2];
+    engineOf[state.sideToMove()] = first;
+    engineOf[state.sideToMove() ^ 1] = first ^ 1;
+    for (auto &engine : m_engines) {
+      if (engine) {
+        engine->clear();
+      }
+    }
+    for (auto &mcts : m_mcts) {
+      if (mcts) {
+        mcts->clear();
+      }
+    }
+
+    int turns = 0;
+    while (!state.isGameOver()) {
+      int engine = engineOf[state.sideToMove()];
+      const isola::SearchLimits &limits = m_match.config.limits;
+      isola::Move move = m_mcts[engine]
+                             ? m_mcts[engine]->search(state, limits).bestMove
+                             : m_engines[engine]->search(state, limits).bestMove;
+      state.makeMove(move);
+      ++turns;
+    }
+
+    int winner = engineOf[state.winner()];
+    finish(game, winner == 0 ? 1 : 0, turns, winner == first);
+  }
+
+private:
+  void finish(std::uint64_t game, int points, int turns, bool firstWon) {
+    std::lock_guard lock(m_match.mutex);
+    m_match.results[game] = static_cast<std::int8_t>(points);
+    m_match.turns += turns;
+    ++m_match.games;
+    m_match.firstMoverWins += firstWon;
+
+    int other = m_match.results[game ^ 1];
+    if (other < 0 || m_match.stop.load(std::memory_order_relaxed)) {
+      return;
+    }
+    Sprt &sprt = m_match.sprt;
+    sprt.add(points + other);
+    bool decided = sprt.verdict() != Verdict::Undecided;
+    if (decided || sprt.pairs() % m_match.config.report == 0) {
+      report(m_match, Clock::now() - m_start);
+    }
+    if (decided) {
+      m_match.stop.store(true, std::memory_order_relaxed);
+    }
+  }
+};
+
+bool parseEngine(std::string_view spec, EngineConfig &config) {
+  config.spec = spec;
+  while (!spec.empty()) {
+    std::size_t comma = std::min(spec.find(','), spec.size());
+    std::string_view setting = spec.substr(0, comma);
+    spec.remove_prefix(std::min(comma + 1, spec.size()));
+
+    std::size_t equals = setting.find('=');
+    std::string_view key = setting.substr(0, equals);
+    std::string_view value =
+        equals == std::string_view::npos ? "" : setting.substr(equals + 1);
+    std::optional<int> number = isola::parseNumber<int>(value);
+
+    if (key == "mcts" && value.empty()) {
+      config.mcts = true;
+    } else if (key == "eval") {
+      if (value == "voronoi") {
+        config.eval = Eval::Voronoi;
+      } else if (value == "mobility") {
+        config.eval = Eval::Mobility;
+      } else if (value == "reach") {
+        config.eval = Eval::Reach;
+      } else {
+        return false;
+      }
+    } else if (key == "arrows" && (value == "near" || value == "all")) {
+      config.options.restrictArrows = value == "near";
+    } else if (key == "tablebase" && !value.empty()) {
+      config.tablebase = value;
+    } else if (key == "network" && !value.empty()) {
+      config.network = value;
+    } else if (!number || *number < 0) {
+      return false;
+    } else if (key == "hash" && *number > 0) {
+      config.hashMB = *number;
+    } else if (key == "radius") {
+      config.options.arrowRadius = *number;
+    } else if (key == "exhaustive") {
+      config.options.exhaustiveArrowsBelow = *number;
+    } else if (key == "partitions" && *number <= 1) {
+      config.options.solvePartitions = *number == 1;
+    } else if (key == "partition-cells") {
+      config.options.partitionSolveCells = *number;
+    } else if (key == "canonical" && *number <= 1) {
+      config.options.canonicalHashing = *number == 1;
+    } else if (key == "pvs" && *number <= 1) {
+      config.options.pvs = *number == 1;
+    } else if (key == "aspiration") {
+      config.options.aspirationDepth = *number;
+    } else if (key == "window" && *number > 0) {
+      config.options.aspirationWindow = *number;
+    } else if (key == "lmr" && *number <= 1) {
+      config.options.lateMoveReductions = *number == 1;
+    } else if (key == "lmr-arrows") {
+      config.options.lateMoveArrows = *number;
+    } else if (key == "reuse" && *number <= 1) {
+      config.mctsOptions.reuseTree = *number == 1;
+    } else if (key == "batch" && *number > 0) {
+      config.batchSize = *number;
+    } else if (key == "in-flight" && *number > 0) {
+      config.mctsOptions.inFlight = *number;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  bool moveTimeGiven = false;
+  bool otherBudget = false;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg{argv[i]};
+    const char *value = argv[i + 1];
+
+    if (arg == "--engine1" || arg == "--engine2") {
+      if (!parseEngine(value, config.engines[arg == "--engine1" ? 0 : 1])) {
+        return false;
+      }
+    } else if (arg == "--book") {
+      config.book = value;
+    } else if (arg == "--opening-plies") {
+      config.openingPlies = std::max(0, std::atoi(value));
+    } else if (arg == "--random-plies") {
+      config.randomPlies = std::max(0, std::atoi(value));
+    } else if (arg == "--movetime") {
+      config.limits.moveTime = std::chrono::milliseconds{std::atoi(value)};
+      moveTimeGiven = true;
+    } else if (arg == "--depth") {
+      config.limits.maxDepth = std::atoi(value);
+      otherBudget = true;
+    } else if (arg == "--nodes") {
+      config.limits.maxNodes = std::strtoull(value, nullptr, 10);
+      otherBudget = true;
+    } else if (arg == "--threads") {
+      config.threads = std::max(1, std::atoi(value));
+    } else if (arg == "--pairs") {
+      config.pairs = std::max<std::uint64_t>(
+          1, std::strtoull(value, nullptr, 10));
+    } else if (arg == "--elo0") {
+      config.elo0 = std::atof(value);
+    } else if (arg == "--elo1") {
+      config.elo1 = std::atof(value);
+    } else if (arg == "--alpha") {
+      config.alpha = std::atof(value);
+    } else if (arg == "--beta") {
+      config.beta = std::atof(value);
+    } else if (arg == "--seed") {
+      config.seed = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--report") {
+      config.report = std::max<std::uint64_t>(
+          1, std::strtoull(value, nullptr, 10));
+    } else if (arg == "--size") {
+      auto size = isola::parseBoardSize(value);
+      if (!size) {
+        return false;
+      }
+      config.size = *size;
+    } else {
+      return false;
+    }
+  }
+  // A depth or node budget replaces the default move time
+  if (otherBudget && !moveTimeGiven) {
+    config.limits.moveTime = std::chrono::milliseconds{0};
+  }
+  return argc % 2 == 1 && config.alpha > 0 && config.alpha < 1 &&
+         config.beta > 0 && config.beta < 1 && config.elo1 > config.elo0;
+}
+
+template <class G> int run(const Config &config) {
+  Match<G> match(config);
+
+  if (config.book) {
+    std::optional<isola::OpeningBook<G>> book =
+        isola::OpeningBook<G>::open(config.book);
+    if (!book) {
+      std::fprintf(stderr, "%s is not an opening book for this board\n",
+                   config.book);
+      return EXIT_FAILURE;
+    }
+    match.openings = bookOpenings(*book, config.openingPlies);
+    if (match.openings.empty()) {
+      std::fprintf(stderr, "%s has no positions %d turns deep\n", config.book,
+                   config.openingPlies);
+      return EXIT_FAILURE;
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    const char *path = config.engines[i].tablebase.c_str();
+    if (*path && !(match.tablebases[i] = isola::Tablebase::open(path))) {
+      std::fprintf(stderr, "%s is not an endgame tablebase\n", path);
+      return EXIT_FAILURE;
+    }
+    path = config.engines[i].network.c_str();
+    if (*path && !(match.networks[i] = isola::BasicNetwork<G>::open(path))) {
+      std::fprintf(stderr, "%s is not an evaluation network for this board\n",
+                   path);
+      return EXIT_FAILURE;
+    }
+
+    const EngineConfig &engine = config.engines[i];
+    if (engine.mcts && match.networks[i]) {
+      match.backends[i] =
+          std::make_unique<isola::NetworkBackend<G>>(*match.networks[i]);
+    } else if (engine.mcts && engine.eval == Eval::Reach) {
+      match.backends[i] = std::make_unique<isola::ReachBackend<G>>();
+    }
+    if (match.backends[i]) {
+      match.queues[i] = std::make_unique<isola::EvalQueue<G>>(
+          *match.backends[i], engine.batchSize);
+    }
+  }
+
+  std::printf("engine1 [%.*s] vs engine2 [%.*s], %s, H0 elo %.1f, H1 elo "
+              "%.1f, %d threads\n",
+              static_cast<int>(config.engines[0].spec.size()),
+              config.engines[0].spec.data(),
+              static_cast<int>(config.engines[1].spec.size()),
+              config.engines[1].spec.data(),
+              match.openings.empty() ? "random openings" : "book openings",
+              config.elo0, config.elo1, config.threads);
+  if (!match.openings.empty()) {
+    std::printf("%zu openings\n", match.openings.size());
+  }
+
+  Clock::time_point start = Clock::now();
+  {
+    std::vector<std::jthread> pool;
+    for (int i = 0; i < config.threads; ++i) {
+      pool.emplace_back([&] {
+        MatchWorker<G> worker(match, start);
+        while (!match.stop.load(std::memory_order_relaxed)) {
+          std::uint64_t game = match.nextGame.fetch_add(1);
+          if (game >= 2 * config.pairs) {
+            break;
+          }
+          worker.play(game);
+        }
+      });
+    }
+  }
+
+  Verdict verdict = match.sprt.verdict();
+  if (match.sprt.pairs() % config.report != 0 &&
+      verdict == Verdict::Undecided) {
+    report(match, Clock::now() - start);
+  }
+  std::printf("%s after %llu games, first mover won %.1f%%, %.1f turns per "
+              "game\n",
+              verdict == Verdict::H1   ? "H1 accepted, engine1 is stronger"
+              : verdict == Verdict::H0 ? "H0 accepted, engine1 is not stronger"
+                                       : "No decision",
+              static_cast<unsigned long long>(match.games),
+              match.games > 0 ? 100.0 * match.firstMoverWins / match.games
+                              : 0.0,
+              match.games > 0 ? static_cast<double>(match.turns) / match.games
+                              : 0.0);
+  for (int i = 0; i < 2; ++i) {
+    if (const isola::EvalQueue<G> *queue = match.queues[i].get()) {
+      std::printf("engine%d %s leaves: %llu batches, %.1f positions each\n",
+                  i + 1, queue->backend().name(),
+                  static_cast<unsigned long long>(queue->batches()),
+                  queue->batches() > 0 ? static_cast<double>(
+                                             queue->positions()) /
+                                             queue->batches()
+                                       : 0.0);
+    }
+  }
+  return verdict == Verdict::H1 ? 0 : verdict == Verdict::H0 ? 2 : 3;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr,
+                 "Usage: %s [--engine1 <spec>] [--engine2 <spec>]\n"
+                 "       [--book <file>] [--opening-plies <n>]\n"
+                 "       [--random-plies <n>] [--movetime <ms>] [--depth <n>]\n"
+                 "       [--nodes <n>] [--threads <n>] [--pairs <n>]\n"
+                 "       [--elo0 <elo>] [--elo1 <elo>] [--alpha <p>]\n"
+                 "       [--beta <p>] [--seed <n>] [--report <pairs>]\n"
+                 "       [--size <rows>x<cols>]\n"
+                 "A spec is a comma separated list of: mcts, "
+                 "eval=voronoi|mobility|reach, hash=<mb>,\n"
+                 "arrows=near|all, radius=<n>, exhaustive=<n>, "
+                 "partitions=0|1, partition-cells=<n>,\n"
+                 "canonical=0|1, pvs=0|1, aspiration=<depth>, window=<n>,\n"
+                 "lmr=0|1, lmr-arrows=<n>, reuse=0|1, tablebase=<file>,\n"
+                 "network=<file>, batch=<n>, in-flight=<n>\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_FAILURE;
+  if (!isola::dispatchGeometry(config.size,
+                               [&]<class G>() { status = run<G>(config); })) {
+    std::fprintf(stderr, "%dx%d boards are not supported\n", config.size.rows,
+                 config.size.cols);
+  }
+  return status;
+}
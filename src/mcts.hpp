@@ -0,0 +1,779 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Monte Carlo tree search, an alternative to the alpha-beta Engine.
+
+    The tree is built on half turns, the same way the alpha-beta search splits
+    them: a step node's children are the squares the side to move can step to,
+    an arrow node's children are the squares it can then shoot. Splitting the
+    turn keeps every node's branching factor to at most 8 steps or one board's
+    worth of arrows instead of their product.
+
+    Every iteration walks down the tree with UCT, expands the leaf once it has
+    been visited often enough, finishes the game with a random playout and
+    backs the winner up the path. All threads share one tree (tree
+    parallelism). A thread counts its visit on the way down, before it knows
+    the result, so until it backs the result up the node looks like a loss to
+    every other thread and they spread out over other lines (virtual loss).
+    Visits and wins are relaxed atomics; children are published with a single
+    release store of the node's state once they are filled in.
+
+    Nodes come from a NodePool allocated once, children of a node are a
+    contiguous run of it. When the pool is full the tree stops growing and the
+    search carries on with playouts from the leaves it has.
+
+    A search whose root was already in the last search's tree, up to two
+    turns below its root, starts from that subtree instead of from
+    scratch: the subtree is moved to the front of the pool and everything
+    else is dropped. Passing the positions of a game in order, or pondering
+    on the expected reply before searching the real one, keeps every
+    playout spent on the line that was played.
+
+    Given an EvalQueue (eval_queue.hpp) the leaves are scored by its backend
+    instead of played out. Every thread then keeps up to inFlight descents
+    waiting for their values at once, backs up whichever has been answered
+    and starts a new one in its place. Once all of them are waiting it
+    scores a batch itself, so a batch holds at least one thread's inFlight
+    leaves and more when other threads queue at the same time. A leaf in
+    the middle of a turn gets the playout arrow first, backends score whole
+    turns. The value is a win probability, the
+    winner backed up is drawn from it so that wins stay counts. The virtual
+    losses of the waiting descents spread them over different leaves.
+
+    Playouts work on the raw bitboards and pick random squares out of a mask
+    directly with nthSquare (pdep + tzcnt on BMI2), without generating moves.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "eval.hpp"
+#include "eval_queue.hpp"
+#include "game_state.hpp"
+#include "search.hpp"
+
+namespace isola {
+
+struct MctsOptions {
+  // Weight of the exploration term in UCT
+  double exploration = 0.8;
+  // A leaf gets its children once it has been visited this often
+  std::uint32_t expandVisits = 2;
+  // Arrows tried in the tree, see SearchOptions
+  bool restrictArrows = true;
+  int arrowRadius = 1;
+  int exhaustiveArrowsBelow = 16;
+  // Playout arrows land next to the opponent whenever there is room
+  bool playoutArrowsNearOpponent = true;
+  // Start from the last search's subtree when the root is in it
+  bool reuseTree = true;
+  // Descents each thread keeps waiting on the evaluation queue, if any
+  int inFlight = 16;
+};
+
+// xorshift64*, a few cycles per number and plenty for playouts
+class PlayoutRandom {
+  std::uint64_t m_state;
+
+public:
+  explicit PlayoutRandom(std::uint64_t seed) : m_state(seed ? seed : 1) {}
+
+  std::uint64_t operator()() {
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+    return m_state * 0x2545f4914f6cdd1d;
+  }
+
+  // A uniformly random set bit of bb, bb must not be empty
+  template <class Mask> Square pick(Mask bb) {
+    std::uint64_t r = (*this)() >> 32;
+    return nthSquare(bb, static_cast<int>((r * popCount(bb)) >> 32));
+  }
+
+  // Uniform in [0, 1)
+  float unit() { return static_cast<float>((*this)() >> 40) * 0x1p-24f; }
+};
+
+struct MctsNode {
+  enum : std::uint8_t { LEAF, EXPANDING, EXPANDED };
+
+  std::atomic<std::uint32_t> visits{0};
+  // Playouts won by the side that made the move leading here
+  std::atomic<std::uint32_t> wins{0};
+  // Only valid once state is EXPANDED, no children at all means the side to
+  // move can't step and has lost
+  std::uint32_t firstChild = 0;
+  std::uint16_t childCount = 0;
+  // The step target or arrow that leads here, NO_SQUARE for the root and for
+  // a step that left nothing to shoot
+  std::int8_t square = NO_SQUARE;
+  std::atomic<std::uint8_t> state{LEAF};
+};
+
+static_assert(sizeof(MctsNode) == 16);
+
+class NodePool {
+  std::unique_ptr<MctsNode[]> m_nodes;
+  std::uint32_t m_capacity = 0;
+  std::atomic<std::uint64_t> m_used{0};
+
+public:
+  static constexpr std::uint32_t FULL = ~std::uint32_t{0};
+
+  explicit NodePool(std::size_t megabytes) { resize(megabytes); }
+
+  void resize(std::size_t megabytes) {
+    // Always room for the root and its children on any board
+    std::size_t count = std::max<std::size_t>(
+        megabytes * 1024 * 1024 / sizeof(MctsNode), MAX_BOARD_SQUARES + 1);
+    m_capacity = static_cast<std::uint32_t>(
+        std::min<std::size_t>(count, FULL - 1));
+    m_nodes.reset(new MctsNode[m_capacity]);
+    clear();
+  }
+
+  std::size_t sizeMB() const {
+    return std::size_t{m_capacity} * sizeof(MctsNode) / (1024 * 1024);
+  }
+
+  // Forgets every node, they are initialized again when handed out
+  void clear() { m_used.store(0, std::memory_order_relaxed); }
+  // Forgets every node but the first `count`
+  void truncate(std::uint32_t count) {
+    m_used.store(std::min(m_used.load(std::memory_order_relaxed),
+                          std::uint64_t{count}),
+                 std::memory_order_relaxed);
+  }
+
+  std::size_t used() const {
+    return std::min<std::uint64_t>(m_used.load(std::memory_order_relaxed),
+                                   m_capacity);
+  }
+
+  // First of `count` consecutive fresh leaves, each leading to the squares
+  // of `squares` in order, or FULL
+  template <class Mask>
+  std::uint32_t allocate(Mask squares, std::uint32_t count) {
+    // Checked first so that threads hammering a full pool can't wrap the
+    // counter around
+    if (m_used.load(std::memory_order_relaxed) + count > m_capacity) {
+      return FULL;
+    }
+    std::uint64_t first = m_used.fetch_add(count, std::memory_order_relaxed);
+    if (first + count > m_capacity) {
+      return FULL;
+    }
+
+    for (std::uint32_t i = 0; i < count; ++i) {
+      MctsNode &node = m_nodes[first + i];
+      node.visits.store(0, std::memory_order_relaxed);
+      node.wins.store(0, std::memory_order_relaxed);
+      node.square = squares ? static_cast<std::int8_t>(popLowest(squares))
+                            : static_cast<std::int8_t>(NO_SQUARE);
+      node.state.store(MctsNode::LEAF, std::memory_order_relaxed);
+    }
+    return static_cast<std::uint32_t>(first);
+  }
+
+  MctsNode &operator[](std::uint32_t index) { return m_nodes[index]; }
+  const MctsNode &operator[](std::uint32_t index) const {
+    return m_nodes[index];
+  }
+};
+
+template <class G> class BasicMctsEngine {
+  using Bitboard = typename G::Bitboard;
+  using GameState = BasicGameState<G>;
+  using Clock = std::chrono::steady_clock;
+
+  // Iterations between two checks of the limits
+  static constexpr std::uint64_t CHECK_INTERVAL = 64;
+  // Used when the search is given neither a time nor a node limit
+  static constexpr std::uint64_t DEFAULT_PLAYOUTS = 100000;
+  // Win rates are reported as a score from -1000 to 1000
+  static constexpr double SCORE_SCALE = 1000;
+  static constexpr int MAX_PATH = 2 * MAX_GAME_TURNS<G> + 1;
+  // How far below the last root a new root is looked for, in half turns.
+  // Within two turns nobody steps twice, which keeps the lookup to one step
+  // per level
+  static constexpr int REUSE_HALF_TURNS = 4;
+
+  // A walk from the root down to a leaf, waiting to be backed up
+  struct Descent {
+    std::uint32_t path[MAX_PATH];
+    // The side that made the move leading to path[i]
+    int movers[MAX_PATH];
+    int length = 0;
+    GameState state;
+    bool arrowPhase = false;
+  };
+
+  // A descent waiting on the evaluation queue
+  struct Pending {
+    Descent descent;
+    EvalRequest<G> request;
+    bool waiting = false;
+  };
+
+  MctsOptions m_options;
+  NodePool m_pool;
+  GameState m_root;
+  // Scores the leaves instead of playouts when set
+  EvalQueue<G> *m_evalQueue = nullptr;
+
+  std::atomic<bool> m_stop{false};
+  std::atomic<std::uint64_t> m_playouts{0};
+  std::atomic<int> m_maxPath{0};
+  std::uint64_t m_maxPlayouts = 0;
+  bool m_hasDeadline = false;
+  Clock::time_point m_deadline;
+
+public:
+  explicit BasicMctsEngine(MctsOptions options = {}, std::size_t poolMB = 32)
+      : m_options(options), m_pool(poolMB) {}
+
+  void setOptions(const MctsOptions &options) { m_options = options; }
+  const MctsOptions &options() const { return m_options; }
+  void setPoolSize(std::size_t megabytes) { m_pool.resize(megabytes); }
+  // Forget the tree of the last search
+  void clear() { m_pool.clear(); }
+  // Leaves are scored by `queue` instead of played out, nullptr goes back to
+  // playouts. The queue has to outlive every search using it
+  void setEvalQueue(EvalQueue<G> *queue) { m_evalQueue = queue; }
+
+  // Asks a running search to return as soon as possible, safe to call from
+  // any thread
+  void stop() { m_stop.store(true, std::memory_order_relaxed); }
+
+  // limits.maxNodes counts playouts, limits.maxDepth is ignored. Playouts
+  // have no iterations to cut short, so a soft time is simply spent in full.
+  // Reports the depth of the deepest line in the tree, in whole turns
+  SearchResult search(const GameState &root, const SearchLimits &limits,
+                      int threads = 1) {
+    Clock::time_point start = Clock::now();
+    threads = std::max(threads, 1);
+
+    SearchResult result;
+    result.threads = threads;
+    if (root.isGameOver()) {
+      result.score = -SCORE_WIN;
+      return result;
+    }
+
+    if (!m_options.reuseTree || !reuseSubtree(root)) {
+      m_pool.clear();
+      m_pool.allocate(Bitboard{0}, 1);
+    }
+    m_root = root;
+    expand(m_pool[0], m_root, false);
+
+    m_stop.store(false, std::memory_order_relaxed);
+    m_playouts.store(0, std::memory_order_relaxed);
+    m_maxPath.store(1, std::memory_order_relaxed);
+    std::chrono::milliseconds moveTime = limits.moveTime;
+    if (limits.softTime.count() > 0 &&
+        (moveTime.count() <= 0 || limits.softTime < moveTime)) {
+      moveTime = limits.softTime;
+    }
+    m_hasDeadline = moveTime.count() > 0;
+    m_deadline = start + moveTime;
+    m_maxPlayouts = limits.maxNodes;
+    if (!m_hasDeadline && m_maxPlayouts == 0) {
+      m_maxPlayouts = DEFAULT_PLAYOUTS;
+    }
+
+    {
+      std::vector<std::jthread> helpers;
+      for (int i = 1; i < threads; ++i) {
+        helpers.emplace_back([this, i] { work(i); });
+      }
+      work(0);
+      stop();
+    }
+
+    result.bestMove = bestMove(result.score, result.ponderMove);
+    result.depth = m_maxPath.load(std::memory_order_relaxed) / 2;
+    result.nodes = m_playouts.load(std::memory_order_relaxed);
+    result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start);
+    return result;
+  }
+
+private:
+  // Moves the node of `root` in the last tree and everything below it to
+  // the front of the pool, false when there is no such node
+  bool reuseSubtree(const GameState &root) {
+    if (m_pool.used() == 0) {
+      return false;
+    }
+    std::uint32_t index = findNode(0, m_root, false, root, REUSE_HALF_TURNS);
+    if (index == NodePool::FULL) {
+      return false;
+    }
+    compact(index);
+    return true;
+  }
+
+  static bool samePosition(const GameState &a, const GameState &b) {
+    return a.hash() == b.hash() && a.dead() == b.dead() &&
+           a.player(0) == b.player(0) && a.player(1) == b.player(1) &&
+           a.sideToMove() == b.sideToMove();
+  }
+
+  // The node below `index` (reached with `state`) for the position
+  // `target`, at most `halfTurns` down, or NodePool::FULL
+  std::uint32_t findNode(std::uint32_t index, const GameState &state,
+                         bool arrowPhase, const GameState &target,
+                         int halfTurns) const {
+    if (!arrowPhase && samePosition(state, target)) {
+      return index;
+    }
+    const MctsNode &node = m_pool[index];
+    if (halfTurns == 0 ||
+        node.state.load(std::memory_order_acquire) != MctsNode::EXPANDED) {
+      return NodePool::FULL;
+    }
+
+    int side = state.sideToMove();
+    for (std::uint32_t i = 0; i < node.childCount; ++i) {
+      std::uint32_t child = node.firstChild + i;
+      Square sq = m_pool[child].square;
+      GameState next = state;
+      if (arrowPhase) {
+        if (sq != NO_SQUARE && !(target.dead() & G::squareBit(sq))) {
+          continue;
+        }
+        next.makeArrow(sq);
+      } else {
+        if (sq != target.player(side)) {
+          continue;
+        }
+        next.makeStep(sq);
+      }
+      std::uint32_t found =
+          findNode(child, next, !arrowPhase, target, halfTurns - 1);
+      if (found != NodePool::FULL) {
+        return found;
+      }
+    }
+    return NodePool::FULL;
+  }
+
+  // Moves the subtree under `index` to the front of the pool, the node
+  // itself becoming the root. Runs of children keep the order they were
+  // allocated in, so every run moves down and never onto one that has yet
+  // to be moved
+  void compact(std::uint32_t index) {
+    struct Run {
+      std::uint32_t from;
+      std::uint32_t count;
+      std::uint32_t to;
+    };
+    std::vector<Run> runs{{.from = index, .count = 1, .to = 0}};
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+      for (std::uint32_t j = 0; j < runs[i].count; ++j) {
+        const MctsNode &node = m_pool[runs[i].from + j];
+        if (node.state.load(std::memory_order_relaxed) ==
+                MctsNode::EXPANDED &&
+            node.childCount > 0) {
+          runs.push_back(
+              {.from = node.firstChild, .count = node.childCount, .to = 0});
+        }
+      }
+    }
+    std::sort(runs.begin(), runs.end(),
+              [](const Run &a, const Run &b) { return a.from < b.from; });
+    std::uint32_t used = 0;
+    for (Run &run : runs) {
+      run.to = used;
+      used += run.count;
+    }
+    auto movedTo = [&](std::uint32_t from) {
+      return std::lower_bound(runs.begin(), runs.end(), from,
+                              [](const Run &run, std::uint32_t first) {
+                                return run.from < first;
+                              })
+          ->to;
+    };
+
+    for (const Run &run : runs) {
+      for (std::uint32_t j = 0; j < run.count; ++j) {
+        MctsNode &from = m_pool[run.from + j];
+        MctsNode &to = m_pool[run.to + j];
+        std::uint32_t visits = from.visits.load(std::memory_order_relaxed);
+        std::uint32_t wins = from.wins.load(std::memory_order_relaxed);
+        std::uint8_t state = from.state.load(std::memory_order_relaxed);
+        std::uint16_t childCount = from.childCount;
+        std::uint32_t firstChild =
+            state == MctsNode::EXPANDED && childCount > 0
+                ? movedTo(from.firstChild)
+                : 0;
+        to.visits.store(visits, std::memory_order_relaxed);
+        to.wins.store(wins, std::memory_order_relaxed);
+        to.square = from.square;
+        to.firstChild = firstChild;
+        to.childCount = childCount;
+        to.state.store(state, std::memory_order_relaxed);
+      }
+    }
+    // The new root is reached by no move
+    m_pool[0].square = NO_SQUARE;
+    m_pool.truncate(used);
+  }
+
+  void work(int id) {
+    PlayoutRandom random(ZOBRIST<G>.side ^ (std::uint64_t(id + 1) << 32) ^
+                         Clock::now().time_since_epoch().count());
+    if (m_evalQueue) {
+      workQueued(random);
+      return;
+    }
+    while (!m_stop.load(std::memory_order_relaxed)) {
+      for (std::uint64_t i = 0; i < CHECK_INTERVAL; ++i) {
+        iterate(random);
+      }
+      countIterations(CHECK_INTERVAL);
+    }
+  }
+
+  // Adds to the iterations of the search and stops it once it is out of
+  // them or of time
+  void countIterations(std::uint64_t count) {
+    std::uint64_t playouts =
+        m_playouts.fetch_add(count, std::memory_order_relaxed) + count;
+    if ((m_maxPlayouts && playouts >= m_maxPlayouts) ||
+        (m_hasDeadline && Clock::now() >= m_deadline)) {
+      stop();
+    }
+  }
+
+  // One select, expand, playout and backup
+  void iterate(PlayoutRandom &random) {
+    Descent descent;
+    int winner = descend(descent);
+    if (winner < 0) {
+      winner = playout(descent.state, descent.arrowPhase, random);
+    }
+    backup(descent, winner);
+  }
+
+  // Iterations whose leaves wait on the evaluation queue, m_options.inFlight
+  // of them at a time. Returns once the search is stopped and every one of
+  // them has been answered and backed up
+  void workQueued(PlayoutRandom &random) {
+    std::size_t slots = static_cast<std::size_t>(
+        std::max(m_options.inFlight, 1));
+    std::unique_ptr<Pending[]> pending(new Pending[slots]);
+    std::uint64_t done = 0;
+    std::size_t waiting = 0;
+    for (;;) {
+      bool stopped = m_stop.load(std::memory_order_relaxed);
+      if (stopped && waiting == 0) {
+        break;
+      }
+
+      bool progress = false;
+      for (std::size_t i = 0; i < slots; ++i) {
+        Pending &slot = pending[i];
+        if (slot.waiting) {
+          if (!slot.request.isReady()) {
+            continue;
+          }
+          int side = slot.request.state.sideToMove();
+          backup(slot.descent,
+                 random.unit() < slot.request.value ? side : side ^ 1);
+          slot.waiting = false;
+          --waiting;
+          ++done;
+          progress = true;
+        }
+        if (stopped) {
+          continue;
+        }
+
+        int winner = descend(slot.descent);
+        if (winner < 0) {
+          winner = finishTurn(slot.descent, random);
+        }
+        if (winner >= 0) {
+          backup(slot.descent, winner);
+          ++done;
+        } else {
+          slot.request.state = slot.descent.state;
+          m_evalQueue->submit(slot.request);
+          slot.waiting = true;
+          ++waiting;
+        }
+        progress = true;
+      }
+
+      if (!stopped && (done >= CHECK_INTERVAL || !progress)) {
+        countIterations(done);
+        done = 0;
+      }
+      // With every descent waiting the thread scores a batch itself,
+      // anyone's
+      if (!progress && !m_evalQueue->dispatch()) {
+        std::this_thread::yield();
+      }
+    }
+    m_playouts.fetch_add(done, std::memory_order_relaxed);
+  }
+
+  // Shoots the playout arrow when the descent ended halfway through a turn,
+  // then returns the winner if the game is over or -1 when the position has
+  // to be evaluated
+  int finishTurn(Descent &descent, PlayoutRandom &random) const {
+    GameState &state = descent.state;
+    if (descent.arrowPhase) {
+      Square players[2] = {state.player(0), state.player(1)};
+      state.makeArrow(playoutArrow(state.dead(), players,
+                                   state.sideToMove(), random));
+      descent.arrowPhase = false;
+    }
+    return state.isGameOver() ? state.winner() : -1;
+  }
+
+  // Walks down from the root, counting a visit on every node on the way and
+  // expanding the leaf once it has been visited often enough. Returns the
+  // winner when the walk ends in a finished game, otherwise -1 and the leaf
+  // still has to be played out or evaluated
+  int descend(Descent &descent) {
+    descent.length = 0;
+    descent.state = m_root;
+    descent.arrowPhase = false;
+    GameState &state = descent.state;
+    std::uint32_t index = 0;
+    for (;;) {
+      MctsNode &node = m_pool[index];
+      descent.path[descent.length++] = index;
+      std::uint32_t visits =
+          node.visits.fetch_add(1, std::memory_order_relaxed) + 1;
+
+      if (node.state.load(std::memory_order_acquire) != MctsNode::EXPANDED &&
+          (visits < m_options.expandVisits ||
+           !expand(node, state, descent.arrowPhase))) {
+        return -1;
+      }
+      if (node.childCount == 0) {
+        return state.sideToMove() ^ 1;
+      }
+
+      index = select(node);
+      descent.movers[descent.length] = state.sideToMove();
+      Square sq = m_pool[index].square;
+      if (descent.arrowPhase) {
+        state.makeArrow(sq);
+      } else {
+        state.makeStep(sq);
+      }
+      descent.arrowPhase = !descent.arrowPhase;
+    }
+  }
+
+  void backup(const Descent &descent, int winner) {
+    // The visits were already counted on the way down
+    for (int i = 1; i < descent.length; ++i) {
+      if (descent.movers[i] == winner) {
+        m_pool[descent.path[i]].wins.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    int length = descent.length;
+    int deepest = m_maxPath.load(std::memory_order_relaxed);
+    while (length > deepest &&
+           !m_maxPath.compare_exchange_weak(deepest, length,
+                                            std::memory_order_relaxed)) {
+    }
+  }
+
+  // Gives the node its children, false when another thread got there first
+  // or the pool is full
+  bool expand(MctsNode &node, const GameState &state, bool arrowPhase) {
+    std::uint8_t expected = MctsNode::LEAF;
+    if (!node.state.compare_exchange_strong(expected, MctsNode::EXPANDING,
+                                            std::memory_order_acquire)) {
+      return expected == MctsNode::EXPANDED;
+    }
+
+    Bitboard squares;
+    std::uint32_t count;
+    if (arrowPhase) {
+      squares = arrowCandidates(
+          state, {.restrictArrows = m_options.restrictArrows,
+                  .arrowRadius = m_options.arrowRadius,
+                  .exhaustiveArrowsBelow = m_options.exhaustiveArrowsBelow});
+      // With nothing left to shoot there is still the one empty arrow
+      count = std::max(popCount(squares), 1);
+    } else {
+      squares = state.stepTargets();
+      count = popCount(squares);
+    }
+
+    std::uint32_t first = 0;
+    if (count > 0) {
+      first = m_pool.allocate(squares, count);
+      if (first == NodePool::FULL) {
+        node.state.store(MctsNode::LEAF, std::memory_order_relaxed);
+        return false;
+      }
+    }
+
+    node.firstChild = first;
+    node.childCount = static_cast<std::uint16_t>(count);
+    node.state.store(MctsNode::EXPANDED, std::memory_order_release);
+    return true;
+  }
+
+  std::uint32_t select(const MctsNode &parent) const {
+    double logVisits =
+        std::log(static_cast<double>(
+            std::max(parent.visits.load(std::memory_order_relaxed), 1u)));
+
+    std::uint32_t best = parent.firstChild;
+    double bestValue = -1;
+    for (std::uint32_t i = 0; i < parent.childCount; ++i) {
+      std::uint32_t index = parent.firstChild + i;
+      const MctsNode &child = m_pool[index];
+      std::uint32_t visits = child.visits.load(std::memory_order_relaxed);
+      if (visits == 0) {
+        return index;
+      }
+
+      double value =
+          static_cast<double>(child.wins.load(std::memory_order_relaxed)) /
+              visits +
+          m_options.exploration * std::sqrt(logVisits / visits);
+      if (value > bestValue) {
+        bestValue = value;
+        best = index;
+      }
+    }
+    return best;
+  }
+
+  // Plays random moves to the end and returns the winner
+  int playout(const GameState &from, bool arrowPhase,
+              PlayoutRandom &random) const {
+    Bitboard dead = from.dead();
+    Square players[2] = {from.player(0), from.player(1)};
+    int side = from.sideToMove();
+
+    for (;;) {
+      if (!arrowPhase) {
+        Bitboard steps = G::neighbors(players[side]) &
+                         ~(dead | G::squareBit(players[0]) |
+                           G::squareBit(players[1])) &
+                         G::BOARD_MASK;
+        if (!steps) {
+          return side ^ 1;
+        }
+        dead |= G::squareBit(players[side]);
+        players[side] = random.pick(steps);
+      }
+      arrowPhase = false;
+
+      Square arrow = playoutArrow(dead, players, side, random);
+      if (arrow != NO_SQUARE) {
+        dead |= G::squareBit(arrow);
+      }
+      side ^= 1;
+    }
+  }
+
+  // The arrow of a playout once `side` has stepped, NO_SQUARE when there is
+  // nothing left to shoot
+  Square playoutArrow(Bitboard dead, const Square players[2], int side,
+                      PlayoutRandom &random) const {
+    Bitboard free =
+        G::BOARD_MASK &
+        ~(dead | G::squareBit(players[0]) | G::squareBit(players[1]));
+    Bitboard targets = free;
+    if (m_options.playoutArrowsNearOpponent) {
+      Bitboard near = G::neighbors(players[side ^ 1]) & free;
+      if (near) {
+        targets = near;
+      }
+    }
+    return targets ? random.pick(targets) : NO_SQUARE;
+  }
+
+  // The parent's child with the most visits, the parent has to have one
+  const MctsNode &mostVisited(const MctsNode &parent) const {
+    const MctsNode *best = &m_pool[parent.firstChild];
+    for (std::uint32_t i = 1; i < parent.childCount; ++i) {
+      const MctsNode &child = m_pool[parent.firstChild + i];
+      if (child.visits.load(std::memory_order_relaxed) >
+          best->visits.load(std::memory_order_relaxed)) {
+        best = &child;
+      }
+    }
+    return *best;
+  }
+
+  static bool hasChildren(const MctsNode &node) {
+    return node.state.load(std::memory_order_acquire) ==
+               MctsNode::EXPANDED &&
+           node.childCount > 0;
+  }
+
+  // The most visited step and the most visited arrow after it, and the same
+  // for the opponent's reply where the tree goes that deep
+  Move bestMove(Score &score, Move &reply) const {
+    const MctsNode *step = &mostVisited(m_pool[0]);
+
+    std::uint32_t visits =
+        std::max(step->visits.load(std::memory_order_relaxed), 1u);
+    double winRate =
+        static_cast<double>(step->wins.load(std::memory_order_relaxed)) /
+        visits;
+    score = static_cast<Score>(std::lround((2 * winRate - 1) * SCORE_SCALE));
+
+    int side = m_root.sideToMove();
+    Move move{.from = static_cast<std::int8_t>(m_root.player(side)),
+              .to = step->square,
+              .arrow = NO_SQUARE};
+
+    reply = NULL_MOVE;
+    if (step->state.load(std::memory_order_acquire) == MctsNode::EXPANDED) {
+      const MctsNode &arrow = mostVisited(*step);
+      move.arrow = arrow.square;
+      if (hasChildren(arrow)) {
+        const MctsNode &replyStep = mostVisited(arrow);
+        if (hasChildren(replyStep)) {
+          reply = {.from = static_cast<std::int8_t>(m_root.player(side ^ 1)),
+                   .to = replyStep.square,
+                   .arrow = mostVisited(replyStep).square};
+        }
+      }
+    } else {
+      // Too few visits to have grown arrows, shoot next to the opponent
+      GameState state = m_root;
+      state.makeStep(move.to);
+      Bitboard free = state.free();
+      Bitboard near = G::neighbors(state.player(side ^ 1)) & free;
+      Bitboard targets = near ? near : free;
+      if (targets) {
+        move.arrow = static_cast<std::int8_t>(lowestSquare(targets));
+      }
+    }
+    return move;
+  }
+};
+
+using MctsEngine = BasicMctsEngine<DefaultGeometry>;
+
+} // namespace isola
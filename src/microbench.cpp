@@ -0,0 +1,329 @@
+/*
+    clang-format off
+
+    isola_microbench: nanoseconds per call of the board primitives.
+
+        isola_microbench [Google Benchmark flags, e.g. --benchmark_filter=copy]
+
+    Built only when Google Benchmark is installed. Every primitive is timed
+    on a midgame position of each board size below, as <primitive>/<size>.
+    The first four are also timed on the string per cell board the game
+    started out with, as <primitive>/<size>/strings, so a change to the board
+    representation can be checked against where it came from as well as
+    against the previous build:
+
+        board_copy          copying the board
+        get_cell            reading a cell's symbol
+        set_cell            writing a cell's symbol
+        has_valid_move      whether a player can still step
+        generate_moves      every (step, arrow) of the side to move
+        make_unmake         playing a move and taking it back
+        zobrist_update      the hash change of a move
+        zobrist_full        hashing the position from scratch
+        eval_voronoi        the search's default evaluation
+        eval_reach          the batch evaluator's scalar evaluation
+        find_partition      checking whether the players are walled off
+
+    clang-format on
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "batch_eval.hpp"
+#include "bitboard.hpp"
+#include "board.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+#include "zobrist.hpp"
+
+namespace {
+
+// The 64-bit boards and the 128-bit one
+using BenchGeometries =
+    isola::GeometryList<isola::Geometry<7, 7>, isola::Geometry<9, 9>,
+                        isola::Geometry<11, 11>>;
+
+// The board before it was packed into bitboards: a symbol per cell
+class StringBoard {
+  int m_rows;
+  int m_cols;
+  std::vector<std::vector<std::string>> m_board;
+
+public:
+  StringBoard(int rows, int cols)
+      : m_rows(rows), m_cols(cols),
+        m_board(rows, std::vector<std::string>(cols, isola::EMPTY_SPOT)) {}
+
+  void setCell(int row, int col, const std::string &symbol) {
+    m_board[row][col] = symbol;
+  }
+
+  const std::string &getCell(int row, int col) const {
+    return m_board[row][col];
+  }
+
+  int rows() const { return m_rows; }
+  int cols() const { return m_cols; }
+};
+
+// checkHasValidMove on the string board, as the game used to do it
+bool stringBoardHasMove(const StringBoard &board, int row, int col) {
+  for (int dr = -1; dr <= 1; ++dr) {
+    for (int dc = -1; dc <= 1; ++dc) {
+      int r = row + dr;
+      int c = col + dc;
+      if ((dr != 0 || dc != 0) && r >= 0 && r < board.rows() && c >= 0 &&
+          c < board.cols() && board.getCell(r, c) == isola::EMPTY_SPOT) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// A third of the board's turns into a random game, the same one every run
+template <class G> isola::BasicGameState<G> midgame() {
+  std::mt19937_64 random(G::SQUARES);
+  isola::BasicMoveList<G> moves;
+  for (;;) {
+    isola::BasicGameState<G> state;
+    for (int turn = 0; turn < G::SQUARES / 6; ++turn) {
+      state.generateMoves(moves);
+      if (moves.empty()) {
+        break;
+      }
+      state.makeMove(moves[random() % moves.size()]);
+    }
+    if (!state.isGameOver()) {
+      return state;
+    }
+  }
+}
+
+template <class G> StringBoard toStringBoard(const isola::BasicBoard<G> &in) {
+  StringBoard board(G::ROWS, G::COLS);
+  for (int row = 0; row < G::ROWS; ++row) {
+    for (int col = 0; col < G::COLS; ++col) {
+      board.setCell(row, col, std::string{in.getCell(row, col)});
+    }
+  }
+  return board;
+}
+
+// Cycles through the squares of a board, one per call
+template <class G> isola::Square nextSquare(isola::Square sq) {
+  return sq + 1 == G::SQUARES ? 0 : sq + 1;
+}
+
+template <class G> void boardCopy(benchmark::State &bench) {
+  isola::BasicBoard<G> board = midgame<G>().toBoard();
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(board);
+    isola::BasicBoard<G> copy = board;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+
+template <class G> void stringBoardCopy(benchmark::State &bench) {
+  StringBoard board = toStringBoard(midgame<G>().toBoard());
+  for (auto _ : bench) {
+    StringBoard copy = board;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+
+template <class G> void getCell(benchmark::State &bench) {
+  isola::BasicBoard<G> board = midgame<G>().toBoard();
+  isola::Square sq = 0;
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(board.getCell(G::rowOf(sq), G::colOf(sq)));
+    sq = nextSquare<G>(sq);
+  }
+}
+
+template <class G> void stringGetCell(benchmark::State &bench) {
+  StringBoard board = toStringBoard(midgame<G>().toBoard());
+  isola::Square sq = 0;
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(board.getCell(G::rowOf(sq), G::colOf(sq)));
+    sq = nextSquare<G>(sq);
+  }
+}
+
+// Writes every cell's own symbol back, so the position stays the same
+template <class G> void setCell(benchmark::State &bench) {
+  isola::BasicBoard<G> board = midgame<G>().toBoard();
+  std::vector<std::string_view> symbols;
+  for (isola::Square sq = 0; sq < G::SQUARES; ++sq) {
+    symbols.push_back(board.getCell(G::rowOf(sq), G::colOf(sq)));
+  }
+  isola::Square sq = 0;
+  for (auto _ : bench) {
+    board.setCell(G::rowOf(sq), G::colOf(sq), symbols[sq]);
+    benchmark::DoNotOptimize(board);
+    sq = nextSquare<G>(sq);
+  }
+}
+
+template <class G> void stringSetCell(benchmark::State &bench) {
+  StringBoard board = toStringBoard(midgame<G>().toBoard());
+  std::vector<std::string> symbols;
+  for (isola::Square sq = 0; sq < G::SQUARES; ++sq) {
+    symbols.push_back(board.getCell(G::rowOf(sq), G::colOf(sq)));
+  }
+  isola::Square sq = 0;
+  for (auto _ : bench) {
+    board.setCell(G::rowOf(sq), G::colOf(sq), symbols[sq]);
+    benchmark::DoNotOptimize(board);
+    sq = nextSquare<G>(sq);
+  }
+}
+
+template <class G> void hasValidMove(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  int side = 0;
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(state);
+    benchmark::DoNotOptimize(G::hasMove(state.player(side), state.free()));
+    side ^= 1;
+  }
+}
+
+template <class G> void stringHasValidMove(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  StringBoard board = toStringBoard(state.toBoard());
+  int side = 0;
+  for (auto _ : bench) {
+    isola::Square sq = state.player(side);
+    benchmark::DoNotOptimize(
+        stringBoardHasMove(board, G::rowOf(sq), G::colOf(sq)));
+    side ^= 1;
+  }
+}
+
+template <class G> void generateMoves(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  isola::BasicMoveList<G> moves;
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(state);
+    state.generateMoves(moves);
+    benchmark::DoNotOptimize(moves);
+  }
+}
+
+template <class G> void makeUnmake(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  isola::BasicMoveList<G> moves;
+  state.generateMoves(moves);
+  std::size_t i = 0;
+  for (auto _ : bench) {
+    state.makeMove(moves[i]);
+    benchmark::DoNotOptimize(state);
+    state.unmakeMove(moves[i]);
+    i = i + 1 == moves.size() ? 0 : i + 1;
+  }
+}
+
+// What makeStep and makeArrow do to the hash between them
+template <class G> void zobristUpdate(benchmark::State &bench) {
+  const isola::ZobristKeys<G> &keys = isola::ZOBRIST<G>;
+  isola::BasicGameState<G> state = midgame<G>();
+  isola::BasicMoveList<G> moves;
+  state.generateMoves(moves);
+  std::uint64_t hash = state.hash();
+  int side = state.sideToMove();
+  std::size_t i = 0;
+  for (auto _ : bench) {
+    isola::Move move = moves[i];
+    hash ^= keys.dead[move.from] ^ keys.player[side][move.from] ^
+            keys.player[side][move.to] ^ keys.side;
+    if (move.arrow != isola::NO_SQUARE) {
+      hash ^= keys.dead[move.arrow];
+    }
+    benchmark::DoNotOptimize(hash);
+    i = i + 1 == moves.size() ? 0 : i + 1;
+  }
+}
+
+template <class G> void zobristFull(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(state);
+    benchmark::DoNotOptimize(state.computeHash());
+  }
+}
+
+template <class G> void evalVoronoi(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(state);
+    benchmark::DoNotOptimize(isola::evalVoronoi(state));
+  }
+}
+
+template <class G> void evalReach(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(state);
+    benchmark::DoNotOptimize(isola::evalReach(state));
+  }
+}
+
+template <class G> void findPartition(benchmark::State &bench) {
+  isola::BasicGameState<G> state = midgame<G>();
+  for (auto _ : bench) {
+    benchmark::DoNotOptimize(state);
+    benchmark::DoNotOptimize(isola::findPartition(state));
+  }
+}
+
+template <class G> void registerGeometry() {
+  std::string size = std::to_string(G::ROWS) + "x" + std::to_string(G::COLS);
+  auto add = [&](const char *name, void (*bench)(benchmark::State &),
+                 const char *suffix = "") {
+    benchmark::RegisterBenchmark(
+        (std::string{name} + "/" + size + suffix).c_str(), bench);
+  };
+
+  add("board_copy", boardCopy<G>);
+  add("board_copy", stringBoardCopy<G>, "/strings");
+  add("get_cell", getCell<G>);
+  add("get_cell", stringGetCell<G>, "/strings");
+  add("set_cell", setCell<G>);
+  add("set_cell", stringSetCell<G>, "/strings");
+  add("has_valid_move", hasValidMove<G>);
+  add("has_valid_move", stringHasValidMove<G>, "/strings");
+  add("generate_moves", generateMoves<G>);
+  add("make_unmake", makeUnmake<G>);
+  add("zobrist_update", zobristUpdate<G>);
+  add("zobrist_full", zobristFull<G>);
+  add("eval_voronoi", evalVoronoi<G>);
+  add("eval_reach", evalReach<G>);
+  add("find_partition", findPartition<G>);
+}
+
+template <class... Geometries>
+void registerAll(isola::GeometryList<Geometries...>) {
+  (registerGeometry<Geometries>(), ...);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  registerAll(BenchGeometries{});
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+/*
+    clang-format off
+
+    A small neural network evaluation, updated incrementally (NNUE).
+
+    The inputs are one bit per square and kind of thing on it, seen from
+    each side in turn (its perspective):
+
+        dead        square is dead
+        mine        the perspective's own player stands on it
+        theirs      the other player stands on it
+
+    Only a handful of them are set at a time, and a turn changes three: the
+    step kills the square it leaves and moves the player, the arrow kills
+    another. So the first layer isn't computed from scratch, its output for
+    each perspective (the accumulator) is the bias plus the weight rows of
+    the inputs that are set, and a turn adds and subtracts the rows of the
+    inputs it changes. The search keeps an accumulator per half turn on a
+    stack and derives the next one from the one before, undoing a move is
+    going back down the stack.
+
+    Evaluating is one small layer on top: both accumulators, the side to
+    move's first, clipped to [0, 1] and multiplied with the output weights.
+    Everything is fixed point int16: the row additions are plain loops the
+    compiler vectorizes, the output layer uses pmaddwd on AVX2 machines,
+    picked at runtime like the batch evaluator's kernels.
+
+        file      header: magic "ISNN", version, rows, cols, hidden size
+                  feature weights   int16 [3 * squares][hidden], times QA
+                  hidden biases     int16 [hidden], times QA
+                  output weights    int16 [2 * hidden], times QB
+                  output bias       int32, times QA * QB
+
+    The output is the logit of the side to move winning, NETWORK_SCORE_SCALE
+    evaluation units each. isola_train fits the weights to the results of
+    self-play records and writes the file. Like the other file formats the
+    weights are used in place from a mapping, in the byte order of the
+    machine that wrote them.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ISOLA_X86_KERNELS 1
+#endif
+
+#include "bitboard.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+#include "mapped_file.hpp"
+
+namespace isola {
+
+constexpr std::uint8_t NETWORK_VERSION = 1;
+// Neurons of the hidden layer, for each perspective
+constexpr int NETWORK_HIDDEN = 64;
+// Hidden activations are clipped to [0, QA], output weights are times QB
+constexpr int NETWORK_QA = 127;
+constexpr int NETWORK_QB = 64;
+// Evaluation units per unit of the output logit
+constexpr int NETWORK_SCORE_SCALE = 16;
+// Every square holds at most one input, so with weights and biases within
+// this limit an accumulator never leaves the int16 range
+constexpr float NETWORK_WEIGHT_LIMIT =
+    32767.0f / ((MAX_BOARD_SQUARES + 1) * NETWORK_QA);
+
+template <class G> constexpr int NETWORK_FEATURES = 3 * G::SQUARES;
+
+// The input of a dead square is the square itself, this is the one of the
+// player of `side` standing on `sq` as seen by `perspective`
+template <class G>
+constexpr int networkPlayerFeature(int perspective, int side, Square sq) {
+  return (side == perspective ? G::SQUARES : 2 * G::SQUARES) + sq;
+}
+
+struct NetworkHeader {
+  char magic[4] = {'I', 'S', 'N', 'N'};
+  std::uint8_t version = NETWORK_VERSION;
+  std::uint8_t rows = 0;
+  std::uint8_t cols = 0;
+  std::uint8_t reserved = 0;
+  std::uint16_t hidden = NETWORK_HIDDEN;
+  std::uint8_t reserved2[6] = {};
+
+  template <class G> static NetworkHeader forGeometry() {
+    NetworkHeader header;
+    header.rows = G::ROWS;
+    header.cols = G::COLS;
+    return header;
+  }
+};
+
+static_assert(sizeof(NetworkHeader) == 16, "weights follow the header");
+
+// The quantized weights, laid out as in the file
+template <class G> struct NetworkWeights {
+  std::int16_t features[NETWORK_FEATURES<G>][NETWORK_HIDDEN];
+  std::int16_t biases[NETWORK_HIDDEN];
+  std::int16_t output[2 * NETWORK_HIDDEN];
+  std::int32_t outputBias;
+};
+
+// The first layer of a position, indexed by perspective
+template <class G> struct BasicAccumulator {
+  alignas(32) std::int16_t values[2][NETWORK_HIDDEN];
+};
+
+inline bool writeNetwork(const char *path, const NetworkHeader &header,
+                         const void *weights, std::size_t size) {
+  std::FILE *file = std::fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(weights, size, 1, file) == 1;
+  return std::fclose(file) == 0 && ok;
+}
+
+template <class G>
+bool writeNetwork(const char *path, const NetworkWeights<G> &weights) {
+  return writeNetwork(path, NetworkHeader::forGeometry<G>(), &weights,
+                      sizeof(weights));
+}
+
+namespace detail {
+
+inline int outputSumScalar(const std::int16_t *us, const std::int16_t *them,
+                           const std::int16_t *weights) {
+  int sum = 0;
+  for (int i = 0; i < NETWORK_HIDDEN; ++i) {
+    sum += std::clamp<int>(us[i], 0, NETWORK_QA) * weights[i];
+    sum += std::clamp<int>(them[i], 0, NETWORK_QA) *
+           weights[NETWORK_HIDDEN + i];
+  }
+  return sum;
+}
+
+#ifdef ISOLA_X86_KERNELS
+
+#define ISOLA_AVX2 __attribute__((target("avx2")))
+
+ISOLA_AVX2 inline int outputSumAvx2(const std::int16_t *us,
+                                    const std::int16_t *them,
+                                    const std::int16_t *weights) {
+  static_assert(NETWORK_HIDDEN % 16 == 0);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i top = _mm256_set1_epi16(NETWORK_QA);
+  __m256i sum = zero;
+  for (int half = 0; half < 2; ++half) {
+    const std::int16_t *in = half == 0 ? us : them;
+    const std::int16_t *w = weights + half * NETWORK_HIDDEN;
+    for (int i = 0; i < NETWORK_HIDDEN; i += 16) {
+      __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+      v = _mm256_min_epi16(_mm256_max_epi16(v, zero), top);
+      // Pairs of products summed into 32-bit lanes
+      sum = _mm256_add_epi32(
+          sum, _mm256_madd_epi16(v, _mm256_loadu_si256(
+                                        reinterpret_cast<const __m256i *>(
+                                            w + i))));
+    }
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                            _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+  return _mm_cvtsi128_si32(s);
+}
+
+#undef ISOLA_AVX2
+
+#endif
+
+} // namespace detail
+
+// A read-only mapping of a network file for one board size
+template <class G> class BasicNetwork {
+  using GameState = BasicGameState<G>;
+  using Accumulator = BasicAccumulator<G>;
+
+  MappedFile m_file;
+  bool m_avx2 = false;
+
+  explicit BasicNetwork(MappedFile file) : m_file(std::move(file)) {}
+
+  const NetworkWeights<G> &weights() const {
+    return *reinterpret_cast<const NetworkWeights<G> *>(
+        m_file.data() + sizeof(NetworkHeader));
+  }
+
+  const std::int16_t *row(int feature) const {
+    return weights().features[feature];
+  }
+
+public:
+  // Nothing when the file can't be mapped or isn't a network for this board
+  static std::optional<BasicNetwork> open(const char *path) {
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file ||
+        file->size() != sizeof(NetworkHeader) + sizeof(NetworkWeights<G>)) {
+      return std::nullopt;
+    }
+    NetworkHeader expected = NetworkHeader::forGeometry<G>();
+    if (std::memcmp(file->data(), &expected, sizeof(expected)) != 0) {
+      return std::nullopt;
+    }
+
+    BasicNetwork network(std::move(*file));
+#ifdef ISOLA_X86_KERNELS
+    network.m_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return network;
+  }
+
+  // The accumulator of `state` from scratch
+  void refresh(const GameState &state, Accumulator &acc) const {
+    for (int perspective = 0; perspective < 2; ++perspective) {
+      std::int16_t *out = acc.values[perspective];
+      std::copy_n(weights().biases, NETWORK_HIDDEN, out);
+      auto add = [&](int feature) {
+        const std::int16_t *w = row(feature);
+        for (int i = 0; i < NETWORK_HIDDEN; ++i) {
+          out[i] = static_cast<std::int16_t>(out[i] + w[i]);
+        }
+      };
+      for (typename G::Bitboard dead = state.dead(); dead;) {
+        add(popLowest(dead));
+      }
+      add(networkPlayerFeature<G>(perspective, 0, state.player(0)));
+      add(networkPlayerFeature<G>(perspective, 1, state.player(1)));
+    }
+  }
+
+  // `out` is `in` after the player of `side` stepped from `from` to `to`
+  void step(const Accumulator &in, Accumulator &out, int side, Square from,
+            Square to) const {
+    const std::int16_t *dead = row(from);
+    for (int perspective = 0; perspective < 2; ++perspective) {
+      const std::int16_t *left =
+          row(networkPlayerFeature<G>(perspective, side, from));
+      const std::int16_t *arrived =
+          row(networkPlayerFeature<G>(perspective, side, to));
+      const std::int16_t *before = in.values[perspective];
+      std::int16_t *after = out.values[perspective];
+      for (int i = 0; i < NETWORK_HIDDEN; ++i) {
+        after[i] = static_cast<std::int16_t>(before[i] + dead[i] +
+                                             arrived[i] - left[i]);
+      }
+    }
+  }
+
+  // `out` is `in` after an arrow on `arrow`, which may be NO_SQUARE
+  void arrow(const Accumulator &in, Accumulator &out, Square arrow) const {
+    if (arrow == NO_SQUARE) {
+      out = in;
+      return;
+    }
+    const std::int16_t *dead = row(arrow);
+    for (int perspective = 0; perspective < 2; ++perspective) {
+      const std::int16_t *before = in.values[perspective];
+      std::int16_t *after = out.values[perspective];
+      for (int i = 0; i < NETWORK_HIDDEN; ++i) {
+        after[i] = static_cast<std::int16_t>(before[i] + dead[i]);
+      }
+    }
+  }
+
+  // The score for the side to move `side` of the position of `acc`
+  Score evaluate(const Accumulator &acc, int side) const {
+    const std::int16_t *us = acc.values[side];
+    const std::int16_t *them = acc.values[side ^ 1];
+    int sum;
+#ifdef ISOLA_X86_KERNELS
+    if (m_avx2) {
+      sum = detail::outputSumAvx2(us, them, weights().output);
+    } else
+#endif
+    {
+      sum = detail::outputSumScalar(us, them, weights().output);
+    }
+    sum += weights().outputBias;
+    Score score = static_cast<Score>(std::int64_t{sum} * NETWORK_SCORE_SCALE /
+                                     (NETWORK_QA * NETWORK_QB));
+    return std::clamp(score, -SCORE_WIN_BOUND + 1, SCORE_WIN_BOUND - 1);
+  }
+
+  Score evaluate(const GameState &state) const {
+    Accumulator acc;
+    refresh(state, acc);
+    return evaluate(acc, state.sideToMove());
+  }
+};
+
+using Network = BasicNetwork<DefaultGeometry>;
+
+} // namespace isola
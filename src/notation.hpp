@@ -0,0 +1,155 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Text notation for squares and moves.
+
+    Squares are written as a column letter and a row number, both counted from
+    the top left corner of the board as it is drawn, so on the standard board
+    the first player starts on d1 and the second on d7. A move is the step
+    followed by the arrow:
+
+        d1-d2/d6    step from d1 to d2, then shoot d6
+        d1-d2       step onto the last free square, nothing left to shoot
+
+    Formatting writes into a caller-provided buffer and parsing works on a view,
+    so neither allocates.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#include "bitboard.hpp"
+#include "game_state.hpp"
+
+namespace isola {
+
+// Longest move text plus a terminating zero, on any board up to 26 columns
+// and 99 rows
+constexpr std::size_t MOVE_TEXT_SIZE = 3 * 3 + 2 + 1;
+
+template <class G> char *formatSquare(Square sq, char *out) {
+  static_assert(G::COLS <= 26 && G::ROWS <= 99);
+  *out++ = static_cast<char>('a' + G::colOf(sq));
+  int row = G::rowOf(sq) + 1;
+  if (row >= 10) {
+    *out++ = static_cast<char>('0' + row / 10);
+  }
+  *out++ = static_cast<char>('0' + row % 10);
+  return out;
+}
+
+// Writes the move without a terminating zero and returns the end of the text
+template <class G> char *formatMove(Move move, char *out) {
+  out = formatSquare<G>(move.from, out);
+  *out++ = '-';
+  out = formatSquare<G>(move.to, out);
+  if (move.arrow != NO_SQUARE) {
+    *out++ = '/';
+    out = formatSquare<G>(move.arrow, out);
+  }
+  return out;
+}
+
+// Reads one square from the front of text and removes it from the view
+template <class G> std::optional<Square> parseSquare(std::string_view &text) {
+  if (text.size() < 2 || text[0] < 'a' || text[0] >= 'a' + G::COLS) {
+    return std::nullopt;
+  }
+  int col = text[0] - 'a';
+  std::size_t i = 1;
+  int row = 0;
+  while (i < text.size() && i < 3 && text[i] >= '0' && text[i] <= '9') {
+    row = row * 10 + (text[i] - '0');
+    ++i;
+  }
+  if (i == 1 || !G::onBoard(row - 1, col)) {
+    return std::nullopt;
+  }
+  text.remove_prefix(i);
+  return G::toSquare(row - 1, col);
+}
+
+// Parses a whole move, the result still has to be checked with isLegal
+template <class G> std::optional<Move> parseMove(std::string_view text) {
+  auto from = parseSquare<G>(text);
+  if (!from || text.empty() || text[0] != '-') {
+    return std::nullopt;
+  }
+  text.remove_prefix(1);
+  auto to = parseSquare<G>(text);
+  if (!to) {
+    return std::nullopt;
+  }
+
+  Move move{.from = static_cast<std::int8_t>(*from),
+            .to = static_cast<std::int8_t>(*to),
+            .arrow = NO_SQUARE};
+  if (text.empty()) {
+    return move;
+  }
+  if (text[0] != '/') {
+    return std::nullopt;
+  }
+  text.remove_prefix(1);
+  auto arrow = parseSquare<G>(text);
+  if (!arrow || !text.empty()) {
+    return std::nullopt;
+  }
+  move.arrow = static_cast<std::int8_t>(*arrow);
+  return move;
+}
+
+// Next space separated word of `text`, removed from it. Empty once the
+// text runs out
+inline std::string_view nextToken(std::string_view &text) {
+  std::size_t start = text.find_first_not_of(' ');
+  if (start == std::string_view::npos) {
+    text = {};
+    return {};
+  }
+  text.remove_prefix(start);
+  std::size_t end = std::min(text.find(' '), text.size());
+  std::string_view token = text.substr(0, end);
+  text.remove_prefix(end);
+  return token;
+}
+
+// The whole of `text` as a number, nothing when anything else is in it
+template <class T> std::optional<T> parseNumber(std::string_view text) {
+  T value{};
+  auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc{} || end != text.data() + text.size() ||
+      text.empty()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// Reads a board size like "7x7", rows first
+inline std::optional<BoardSize> parseBoardSize(std::string_view text) {
+  BoardSize size{};
+  auto [rowsEnd, rowsError] =
+      std::from_chars(text.data(), text.data() + text.size(), size.rows);
+  if (rowsError != std::errc{} || rowsEnd == text.data() + text.size() ||
+      *rowsEnd != 'x') {
+    return std::nullopt;
+  }
+  auto [colsEnd, colsError] =
+      std::from_chars(rowsEnd + 1, text.data() + text.size(), size.cols);
+  if (colsError != std::errc{} || colsEnd != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return size;
+}
+
+} // namespace isola
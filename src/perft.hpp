@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+    Perft: counts the leaves of the full move tree to a fixed depth in turns.
+    Any change to the board representation or the move generator has to leave
+    these counts alone, which makes them both a correctness check and a
+    benchmark of generateMoves / makeMove / unmakeMove.
+*/
+
+#include <cstdint>
+
+#include "game_state.hpp"
+
+namespace isola {
+
+template <class G> std::uint64_t perft(BasicGameState<G> &state, int depth) {
+  if (depth <= 0) {
+    return 1;
+  }
+
+  BasicMoveList<G> moves;
+  state.generateMoves(moves);
+
+  // Bulk count the last ply instead of making and unmaking every leaf
+  if (depth == 1) {
+    return moves.size();
+  }
+
+  std::uint64_t nodes = 0;
+  for (Move move : moves) {
+    state.makeMove(move);
+    nodes += perft(state, depth - 1);
+    state.unmakeMove(move);
+  }
+  return nodes;
+}
+
+} // namespace isola
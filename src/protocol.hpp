@@ -0,0 +1,244 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Batch protocol for scripts and tournament managers, modelled on UCI.
+
+    Commands are read one line at a time and answered without prompts, rules
+    or redraws, so a single process can work through any number of positions:
+
+        uci                         id name isola, the options, then uciok
+        isready                     readyok
+        ucinewgame                  forgets everything learned so far
+        setoption name <Hash|Threads> value <n>
+        position startpos [moves <move>...]
+        position board <rows> <B|W> [moves <move>...]
+                                    rows as in the server, separated by '/'
+        go [movetime <ms>] [depth <n>] [nodes <n>]
+           [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>]
+                                    info depth .. score .. nodes .. time ..,
+                                    then bestmove <move> [ponder <move>],
+                                    or bestmove none when the side to move
+                                    has lost
+        quit
+
+    Moves are written as in notation.hpp. btime and binc are B's clock,
+    wtime and winc W's. go with a clock for the side to move plays on that
+    clock like the interactive game does, and go without
+    any limit thinks for the --movetime of the command line. The search runs
+    before the next line is read, there is no stop or ponder command: the
+    ponder of bestmove only names the reply the engine expects. Mistakes are
+    answered with info string and otherwise ignored, a bad position command
+    leaves the position as it was. Everything the engine learned is kept
+    until ucinewgame, the table and, with MCTS, the tree below the new
+    position when it was reached by playing on from the last one.
+
+    Output is only flushed once no more input is waiting, so a piped batch of
+    positions is answered in large writes.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "board.hpp"
+#include "game_state.hpp"
+#include "mcts.hpp"
+#include "notation.hpp"
+#include "search.hpp"
+#include "timeman.hpp"
+
+namespace isola {
+
+template <class G> class BasicProtocol {
+  using GameState = BasicGameState<G>;
+
+  BasicEngine<G> &m_engine;
+  // Searches instead of m_engine when set
+  BasicMctsEngine<G> *m_mcts;
+  int m_threads;
+  // Think time of a go without limits, never zero since nothing could stop
+  // that search
+  std::chrono::milliseconds m_moveTime;
+  GameState m_state;
+
+public:
+  BasicProtocol(BasicEngine<G> &engine, BasicMctsEngine<G> *mcts, int threads,
+                std::chrono::milliseconds moveTime)
+      : m_engine(engine), m_mcts(mcts), m_threads(threads),
+        m_moveTime(std::max(moveTime, std::chrono::milliseconds{1})) {}
+
+  // Answers commands from `in` until quit or the end of the input
+  void run(std::istream &in, std::ostream &out) {
+    std::string line;
+    while (std::getline(in, line)) {
+      std::string_view rest = line;
+      if (!rest.empty() && rest.back() == '\r') {
+        rest.remove_suffix(1);
+      }
+      std::string_view command = nextToken(rest);
+
+      if (command == "quit") {
+        break;
+      } else if (command == "uci") {
+        out << "id name isola\n"
+               "option name Hash type spin default "
+            << TranspositionTable::DEFAULT_SIZE_MB
+            << " min 1 max 65536\n"
+               "option name Threads type spin default 1 min 1 max 256\n"
+               "uciok\n";
+      } else if (command == "isready") {
+        out << "readyok\n";
+      } else if (command == "ucinewgame") {
+        m_engine.clear();
+        if (m_mcts) {
+          m_mcts->clear();
+        }
+        m_state = GameState();
+      } else if (command == "setoption") {
+        setOption(rest, out);
+      } else if (command == "position") {
+        position(rest, out);
+      } else if (command == "go") {
+        go(rest, out);
+      } else if (!command.empty()) {
+        out << "info string unknown command " << command << "\n";
+      }
+
+      if (in.rdbuf()->in_avail() <= 0) {
+        out.flush();
+      }
+    }
+    out.flush();
+  }
+
+private:
+  void setOption(std::string_view rest, std::ostream &out) {
+    std::string_view nameKey = nextToken(rest);
+    std::string_view name = nextToken(rest);
+    std::string_view valueKey = nextToken(rest);
+    std::optional<int> value = parseNumber<int>(nextToken(rest));
+    if (nameKey != "name" || valueKey != "value" || !value || *value < 1) {
+      out << "info string usage: setoption name <Hash|Threads> value <n>\n";
+    } else if (name == "Hash") {
+      m_engine.setHashSize(*value);
+    } else if (name == "Threads") {
+      m_threads = *value;
+    } else {
+      out << "info string unknown option " << name << "\n";
+    }
+  }
+
+  void position(std::string_view rest, std::ostream &out) {
+    std::string_view kind = nextToken(rest);
+    GameState state;
+    if (kind == "board") {
+      std::optional<BasicBoard<G>> board =
+          BasicBoard<G>::fromString(nextToken(rest));
+      std::string_view side = nextToken(rest);
+      if (!board || (side != PLAYER_ONE && side != PLAYER_TWO)) {
+        out << "info string not a " << G::ROWS << "x" << G::COLS
+            << " board and side to move\n";
+        return;
+      }
+      state = GameState(*board, side == PLAYER_ONE ? 0 : 1);
+    } else if (kind != "startpos") {
+      out << "info string usage: position startpos|board <rows> <B|W> "
+             "[moves ...]\n";
+      return;
+    }
+
+    std::string_view movesKey = nextToken(rest);
+    if (!movesKey.empty() && movesKey != "moves") {
+      out << "info string expected moves, not " << movesKey << "\n";
+      return;
+    }
+    for (std::string_view text = nextToken(rest); !text.empty();
+         text = nextToken(rest)) {
+      std::optional<Move> move = parseMove<G>(text);
+      if (!move || !state.isLegal(*move)) {
+        out << "info string illegal move " << text << "\n";
+        return;
+      }
+      state.makeMove(*move);
+    }
+    m_state = state;
+  }
+
+  void go(std::string_view rest, std::ostream &out) {
+    SearchLimits limits;
+    // Indexed by side
+    std::optional<GameClock> clocks[2];
+    auto clockOf = [&](int side) -> GameClock & {
+      return clocks[side] ? *clocks[side] : clocks[side].emplace();
+    };
+    for (std::string_view key = nextToken(rest); !key.empty();
+         key = nextToken(rest)) {
+      std::optional<std::int64_t> value =
+          parseNumber<std::int64_t>(nextToken(rest));
+      if (!value || *value < 0) {
+        out << "info string " << key << " needs a number\n";
+        return;
+      }
+      std::chrono::milliseconds ms{*value};
+      int side = key[0] == 'w' ? 1 : 0;
+      if (key == "movetime") {
+        limits.moveTime = ms;
+      } else if (key == "depth") {
+        limits.maxDepth = static_cast<int>(*value);
+      } else if (key == "nodes") {
+        limits.maxNodes = *value;
+      } else if (key == "wtime" || key == "btime") {
+        clockOf(side).remaining = ms;
+      } else if (key == "winc" || key == "binc") {
+        // Only counts together with the side's time
+        clockOf(side).increment = ms;
+      } else if (key == "movestogo") {
+        clockOf(0).movesToGo = static_cast<int>(*value);
+        clockOf(1).movesToGo = static_cast<int>(*value);
+      } else {
+        out << "info string unknown go parameter " << key << "\n";
+        return;
+      }
+    }
+
+    const std::optional<GameClock> &clock = clocks[m_state.sideToMove()];
+    if (clock && clock->remaining.count() > 0) {
+      limits = allocateTime(m_state, *clock, limits);
+    } else if (limits.moveTime.count() == 0 && limits.maxNodes == 0 &&
+               limits.maxDepth == SearchLimits{}.maxDepth) {
+      limits.moveTime = m_moveTime;
+    }
+
+    if (m_state.isGameOver()) {
+      out << "bestmove none\n";
+      return;
+    }
+    SearchResult result = m_mcts ? m_mcts->search(m_state, limits, m_threads)
+                                 : m_engine.search(m_state, limits, m_threads);
+
+    char move[MOVE_TEXT_SIZE];
+    *formatMove<G>(result.bestMove, move) = '\0';
+    out << "info depth " << result.depth << " score " << result.score
+        << " nodes " << result.nodes << " time "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(
+               result.elapsed)
+               .count()
+        << (result.fromBook ? " book" : "") << "\nbestmove " << move;
+    if (result.ponderMove != NULL_MOVE) {
+      *formatMove<G>(result.ponderMove, move) = '\0';
+      out << " ponder " << move;
+    }
+    out << "\n";
+  }
+};
+
+} // namespace isola
@@ -0,0 +1,294 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Binary game records.
+
+    A record file is a 16 byte file header followed by fixed size game
+    records, so game i always starts at HEADER_SIZE + i * RECORD_SIZE<G> and
+    a reader can jump to any game without scanning:
+
+        file header   magic "ISGR", version, rows, cols, record size, reserved
+        game record   turns, winner, then one byte pair per turn:
+                          the square stepped to
+                          the square shot, NO_ARROW when nothing was left
+
+    Every game starts from the default GameState, and the square a step comes
+    from is wherever the side to move is standing, so the step target alone is
+    enough to replay it. Everything is single bytes, so files don't depend on
+    the endianness or alignment of the machine that wrote them.
+
+    RecordWriter appends records through a large buffer so writing hundreds of
+    millions of games is a handful of big writes. RecordFile maps a file into
+    memory and hands out records in place, nothing is copied or parsed until a
+    game is replayed.
+
+    The record size follows from the board, 96 bytes on the standard one. A
+    file can only be opened with the geometry it was written for;
+    recordBoardSize reads the size from the header to dispatch on.
+
+    clang-format on
+*/
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "bitboard.hpp"
+#include "game_state.hpp"
+#include "mapped_file.hpp"
+
+namespace isola {
+
+static_assert(MAX_BOARD_SQUARES < 0xff, "a square has to fit in one byte");
+
+constexpr std::uint8_t RECORD_VERSION = 1;
+constexpr std::uint8_t NO_ARROW = 0xff;
+
+struct RecordedTurn {
+  std::uint8_t step;
+  std::uint8_t arrow;
+};
+
+template <class G> struct BasicGameRecord {
+  std::uint8_t turns = 0;
+  std::uint8_t winner = 0;
+  RecordedTurn moves[MAX_GAME_TURNS<G>];
+
+  // The full move of turn `turn`, `before` being the position it was played
+  // from
+  Move move(int turn, const BasicGameState<G> &before) const {
+    return {.from = static_cast<std::int8_t>(
+                before.player(before.sideToMove())),
+            .to = static_cast<std::int8_t>(moves[turn].step),
+            .arrow = moves[turn].arrow == NO_ARROW
+                         ? static_cast<std::int8_t>(NO_SQUARE)
+                         : static_cast<std::int8_t>(moves[turn].arrow)};
+  }
+
+  // Plays the game from the start, calling visit(state, move) before every
+  // move is made. Records come straight from files, so nothing when the
+  // record is corrupt: too many turns, no such winner or an illegal move.
+  // visit has then already seen the moves before the illegal one
+  template <typename Visitor>
+  std::optional<BasicGameState<G>> replay(Visitor &&visit) const {
+    if (turns > MAX_GAME_TURNS<G> || winner > 1) {
+      return std::nullopt;
+    }
+    BasicGameState<G> state;
+    for (int turn = 0; turn < turns; ++turn) {
+      Move played = move(turn, state);
+      if (!state.isLegal(played)) {
+        return std::nullopt;
+      }
+      visit(std::as_const(state), played);
+      state.makeMove(played);
+    }
+    return state;
+  }
+};
+
+template <class G>
+constexpr std::size_t RECORD_SIZE = sizeof(BasicGameRecord<G>);
+
+struct RecordHeader {
+  char magic[4] = {'I', 'S', 'G', 'R'};
+  std::uint8_t version = RECORD_VERSION;
+  std::uint8_t rows = 0;
+  std::uint8_t cols = 0;
+  std::uint8_t recordSize = 0;
+  std::uint8_t reserved[8] = {};
+
+  // The header of files holding games on G
+  template <class G> static RecordHeader forGeometry() {
+    static_assert(RECORD_SIZE<G> == 2 + 2 * MAX_GAME_TURNS<G> &&
+                      RECORD_SIZE<G> <= 0xff,
+                  "records are written and mapped as raw bytes");
+    RecordHeader header;
+    header.rows = G::ROWS;
+    header.cols = G::COLS;
+    header.recordSize = RECORD_SIZE<G>;
+    return header;
+  }
+
+  // Whether a file with this header holds games on G readable by this build
+  template <class G> bool compatible() const {
+    RecordHeader expected = forGeometry<G>();
+    return std::memcmp(this, &expected, sizeof(RecordHeader)) == 0;
+  }
+};
+
+constexpr std::size_t HEADER_SIZE = sizeof(RecordHeader);
+static_assert(HEADER_SIZE == 16);
+
+// Board size of a record file, to pick the geometry to open it with. Nothing
+// when the file can't be read or isn't a record file
+inline std::optional<BoardSize> recordBoardSize(const char *path) {
+  std::FILE *file = std::fopen(path, "rb");
+  if (!file) {
+    return std::nullopt;
+  }
+  RecordHeader header;
+  bool read = std::fread(&header, HEADER_SIZE, 1, file) == 1;
+  std::fclose(file);
+
+  RecordHeader expected;
+  if (!read || std::memcmp(header.magic, expected.magic, 4) != 0 ||
+      header.version != RECORD_VERSION) {
+    return std::nullopt;
+  }
+  return BoardSize{header.rows, header.cols};
+}
+
+template <class G>
+BasicGameRecord<G> makeRecord(const Move *moves, int turns, int winner) {
+  assert(turns <= MAX_GAME_TURNS<G>);
+  BasicGameRecord<G> record;
+  record.turns = static_cast<std::uint8_t>(turns);
+  record.winner = static_cast<std::uint8_t>(winner);
+  for (int i = 0; i < turns; ++i) {
+    record.moves[i].step = static_cast<std::uint8_t>(moves[i].to);
+    record.moves[i].arrow = moves[i].arrow == NO_SQUARE
+                                ? NO_ARROW
+                                : static_cast<std::uint8_t>(moves[i].arrow);
+  }
+  // Unused turns are zeroed so identical games give identical bytes
+  std::memset(record.moves + turns, 0,
+              sizeof(RecordedTurn) * (MAX_GAME_TURNS<G> - turns));
+  return record;
+}
+
+template <class G> class RecordWriter {
+  using GameRecord = BasicGameRecord<G>;
+
+  std::FILE *m_file = nullptr;
+  std::unique_ptr<GameRecord[]> m_buffer;
+  std::size_t m_capacity;
+  std::size_t m_used = 0;
+  bool m_ok = false;
+
+public:
+  // A megabyte or more per write
+  static constexpr std::size_t DEFAULT_BUFFER_RECORDS = 1 << 14;
+
+  explicit RecordWriter(const char *path,
+                        std::size_t bufferRecords = DEFAULT_BUFFER_RECORDS)
+      : m_file(std::fopen(path, "wb")),
+        m_buffer(new GameRecord[bufferRecords]), m_capacity(bufferRecords) {
+    if (m_file) {
+      RecordHeader header = RecordHeader::forGeometry<G>();
+      m_ok = std::fwrite(&header, HEADER_SIZE, 1, m_file) == 1;
+    }
+  }
+
+  RecordWriter(const RecordWriter &) = delete;
+  RecordWriter &operator=(const RecordWriter &) = delete;
+
+  ~RecordWriter() { close(); }
+
+  // False once opening or any write has failed
+  bool ok() const { return m_ok; }
+
+  void append(const GameRecord &record) {
+    if (m_used == m_capacity) {
+      flush();
+    }
+    m_buffer[m_used++] = record;
+  }
+
+  // Large batches skip the buffer and go straight to the file
+  void append(const GameRecord *records, std::size_t count) {
+    if (count >= m_capacity) {
+      flush();
+      write(records, count);
+      return;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      append(records[i]);
+    }
+  }
+
+  void flush() {
+    write(m_buffer.get(), m_used);
+    m_used = 0;
+  }
+
+  bool close() {
+    if (m_file) {
+      flush();
+      m_ok &= std::fclose(m_file) == 0;
+      m_file = nullptr;
+    }
+    return m_ok;
+  }
+
+private:
+  void write(const GameRecord *records, std::size_t count) {
+    if (m_file && count > 0) {
+      m_ok &= std::fwrite(records, RECORD_SIZE<G>, count, m_file) == count;
+    }
+  }
+};
+
+// A read-only mapping of a record file
+template <class G> class RecordFile {
+  using GameRecord = BasicGameRecord<G>;
+
+  MappedFile m_file;
+  std::size_t m_size;
+
+  explicit RecordFile(MappedFile file)
+      : m_file(std::move(file)),
+        m_size((m_file.size() - HEADER_SIZE) / RECORD_SIZE<G>) {}
+
+public:
+  // Nothing when the file can't be mapped or was written for another board
+  static std::optional<RecordFile> open(const char *path) {
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file || file->size() < HEADER_SIZE) {
+      return std::nullopt;
+    }
+
+    RecordFile records(std::move(*file));
+    if (!records.header().template compatible<G>()) {
+      return std::nullopt;
+    }
+    records.m_file.advise(MADV_SEQUENTIAL);
+    return records;
+  }
+
+  RecordFile(RecordFile &&other) noexcept
+      : m_file(std::move(other.m_file)),
+        m_size(std::exchange(other.m_size, 0)) {}
+
+  RecordFile &operator=(RecordFile &&other) noexcept {
+    std::swap(m_file, other.m_file);
+    std::swap(m_size, other.m_size);
+    return *this;
+  }
+
+  const RecordHeader &header() const {
+    return *reinterpret_cast<const RecordHeader *>(m_file.data());
+  }
+
+  // A trailing partial record, left by a writer that was cut off, is ignored
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  const GameRecord &operator[](std::size_t i) const { return begin()[i]; }
+
+  const GameRecord *begin() const {
+    return reinterpret_cast<const GameRecord *>(m_file.data() + HEADER_SIZE);
+  }
+  const GameRecord *end() const { return begin() + m_size; }
+};
+
+using GameRecord = BasicGameRecord<DefaultGeometry>;
+
+} // namespace isola
@@ -0,0 +1,952 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Computer opponent for Isola.
+
+    Negamax alpha-beta search driven by iterative deepening, so the engine
+    always has the best move of the last finished depth ready when the time
+    budget runs out.
+
+    Each turn is searched as two half-plies of the same side: first the step,
+    then the arrow. Depth still counts whole turns. Splitting the turn lets
+    moves be ordered and cut off per step instead of per (step, arrow) pair,
+    and lets the arrow half-ply only look at squares near either player:
+    an arrow far away from both pieces rarely matters until the endgame, where
+    the search goes back to trying every free square.
+
+    Positions reached through different move orders share results through the
+    transposition table, which is probed at the start of every turn. While
+    the root is symmetric, like the start position, mirrored positions share
+    their entries too (see symmetry.hpp).
+
+    Once the players are walled off from each other the position is scored
+    exactly by the partition solver instead of being searched any further.
+    Regions in the endgame tablebase, when one is set, are solved this way
+    whatever their size.
+    Everything else is scored by the territory evaluation unless the engine
+    is given another evaluator, or a network (see nnue.hpp). The search then
+    keeps the network's accumulator up to date half turn by half turn.
+
+    Positions in the opening book, when one is set, are answered from the
+    book without searching.
+
+    Searching with several threads uses Lazy SMP: every thread runs its own
+    iterative deepening over the same root with its own killers and history,
+    and the threads only talk through the shared transposition table. Helpers
+    start at alternating depths so they wander off into different parts of the
+    tree and fill the table with results the main thread picks up for free.
+
+    Moves are tried in the order
+        1. Best move of the previous iteration (root) or the table's move
+        2. Killer steps / arrows that caused a cutoff at the same ply
+        3. History score of the step / arrow for the side to move
+    The search never allocates, every ply keeps its move list on the stack.
+
+    With that order the first move is usually the best one, so the rest are
+    only searched with a null window to prove they are worse (PVS), and
+    arrows late in the order, the bulk of a turn's fan-out, with a turn less
+    on top. A late arrow that still beats alpha is searched again at full
+    depth before it is believed. Iterations start with an aspiration window
+    around the previous score, which is widened and searched again when the
+    score falls outside of it.
+
+    Builds with ISOLA_STATS count nodes, table hits and cutoffs per ply and
+    time partition checks and evaluations, per thread (see stats.hpp).
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "book.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "game_state.hpp"
+#include "nnue.hpp"
+#include "stats.hpp"
+#include "symmetry.hpp"
+#include "tablebase.hpp"
+#include "tt.hpp"
+
+namespace isola {
+
+struct SearchLimits {
+  std::chrono::milliseconds moveTime{0}; // zero means no time limit
+  int maxDepth = MAX_PLY;
+  std::uint64_t maxNodes = 0; // zero means no node limit
+  // Time the search aims for, zero to always use up moveTime. No new
+  // iteration starts past it, sooner while the best move stays the same.
+  // moveTime is still the hard limit, see timeman.hpp
+  std::chrono::milliseconds softTime{0};
+};
+
+struct SearchOptions {
+  // Only shoot arrows within this many king moves of either player
+  bool restrictArrows = true;
+  int arrowRadius = 1;
+  // Try every arrow once this few free squares are left
+  int exhaustiveArrowsBelow = 16;
+  // Score positions where the players are walled off exactly, as long as
+  // neither region is bigger than this or both are in the tablebase
+  bool solvePartitions = true;
+  int partitionSolveCells = 10;
+  // Share transposition table entries between mirrored positions while the
+  // root is symmetric, see symmetry.hpp
+  bool canonicalHashing = true;
+  // Principal variation search: every move after the first is tried with a
+  // null window and only searched again when it beats alpha
+  bool pvs = true;
+  // Iterations from aspirationDepth on start with a window this wide around
+  // the last score, 0 searches every iteration with a full window
+  int aspirationDepth = 4;
+  Score aspirationWindow = 2 * VORONOI_TERRITORY_WEIGHT;
+  // Arrows after the first lateMoveArrows are searched a turn shallower, and
+  // searched again at full depth when they beat alpha
+  bool lateMoveReductions = true;
+  int lateMoveArrows = 3;
+};
+
+struct SearchResult {
+  Move bestMove = NULL_MOVE;
+  Score score = 0;
+  int depth = 0;
+  // Summed over all threads
+  std::uint64_t nodes = 0;
+  int threads = 1;
+  std::chrono::microseconds elapsed{0};
+  // The move came from the opening book, depth and score are the book's
+  bool fromBook = false;
+  // The opponent's answer to bestMove the search expects, NULL_MOVE when it
+  // has no idea. What to ponder on while the opponent thinks
+  Move ponderMove = NULL_MOVE;
+
+  double nodesPerSecond() const {
+    return elapsed.count() > 0 ? nodes * 1e6 / elapsed.count() : 0.0;
+  }
+};
+
+// Squares worth shooting at in the current position, the side to move has
+// already stepped
+template <class G>
+typename G::Bitboard arrowCandidates(const BasicGameState<G> &state,
+                                     const SearchOptions &options) {
+  using Bitboard = typename G::Bitboard;
+
+  Bitboard free = state.free();
+  if (!options.restrictArrows ||
+      popCount(free) < options.exhaustiveArrowsBelow) {
+    return free;
+  }
+
+  Bitboard near =
+      G::squareBit(state.player(0)) | G::squareBit(state.player(1));
+  for (int i = 0; i < options.arrowRadius; ++i) {
+    near = G::dilate(near);
+  }
+
+  // An arrow has to go somewhere even when nothing is nearby
+  Bitboard candidates = free & near;
+  return candidates ? candidates : free;
+}
+
+// Everything the threads of one search share
+template <class G> struct SearchShared {
+  using Clock = std::chrono::steady_clock;
+
+  BasicEvaluator<G> eval = evalVoronoi<G>;
+  SearchOptions options;
+  TranspositionTable tt;
+  const Tablebase *tablebase = nullptr;
+  // Evaluates instead of eval when set
+  const BasicNetwork<G> *network = nullptr;
+  // Symmetries of the root the table keys are canonical under
+  unsigned symmetries = 0;
+
+  std::atomic<bool> stop{false};
+  std::atomic<std::uint64_t> nodes{0};
+
+  std::uint64_t maxNodes = 0;
+  Clock::time_point start;
+  Clock::time_point deadline;
+  bool hasDeadline = false;
+  std::chrono::milliseconds softTime{0};
+};
+
+// One search thread with its own move ordering tables
+template <class G> class SearchWorker {
+  using Bitboard = typename G::Bitboard;
+  using GameState = BasicGameState<G>;
+  using MoveList = BasicMoveList<G>;
+  using Clock = std::chrono::steady_clock;
+
+  // Nodes searched between two looks at the clock and the node limit. A
+  // node takes well under a microsecond, so a look every 1024 of them keeps
+  // a thread within a millisecond of the deadline
+  static constexpr std::uint64_t CLOCK_STRIDE = 1024;
+
+  // Share of the soft time after which no new iteration starts, by how many
+  // iterations in a row have kept the same best move
+  static constexpr int STABLE_TIME_PERCENT[] = {150, 100, 80, 65, 50};
+
+  static constexpr int HASH_MOVE_BONUS = 1 << 29;
+  static constexpr int KILLER_BONUS = 1 << 28;
+  static constexpr int PREVIOUS_BEST_BONUS = 1 << 29;
+  // History is halved once any entry grows past this
+  static constexpr int HISTORY_LIMIT = 1 << 20;
+
+  // Moves picked one by one before sorting the rest of the list in one go.
+  // Most cutoffs happen on the first few moves, and the few nodes that search
+  // everything shouldn't pay a quadratic selection sort over dozens of moves
+  static constexpr std::size_t LAZY_PICKS = 4;
+
+  struct ScoredMove {
+    Move move;
+    int score;
+  };
+
+  struct ScoredSquare {
+    Square sq;
+    int score;
+  };
+
+  int m_id;
+  SearchShared<G> &m_shared;
+  WalkSolver<G> m_walks;
+
+  Square m_stepKillers[MAX_PLY][2];
+  Square m_arrowKillers[MAX_PLY][2];
+  // Indexed by [side][step target]
+  int m_stepHistory[2][G::SQUARES];
+  // Indexed by [side][step target][arrow target]
+  int m_arrowHistory[2][G::SQUARES][G::SQUARES];
+  // The network's accumulators of the current line, at 2 * ply at the
+  // start of a turn and at 2 * ply + 1 after its step
+  BasicAccumulator<G> m_accumulators[2 * MAX_PLY + 1];
+
+  std::uint64_t m_nodes = 0;
+  // Part of m_nodes already added to the shared counter
+  std::uint64_t m_flushedNodes = 0;
+  // m_nodes at the next look at the clock
+  std::uint64_t m_nextPoll = 0;
+  [[no_unique_address]] StatsRecorder m_stats;
+
+  // Last iteration this thread finished
+  Move m_bestMove = NULL_MOVE;
+  Score m_score = 0;
+  int m_depth = 0;
+
+public:
+  SearchWorker(int id, SearchShared<G> &shared) : m_id(id), m_shared(shared) {
+    clear();
+  }
+
+  bool isMain() const { return m_id == 0; }
+
+  Move bestMove() const { return m_bestMove; }
+  Score score() const { return m_score; }
+  int depth() const { return m_depth; }
+  // Adds what this thread counted in the last search, nothing without
+  // ISOLA_STATS
+  void addStats(SearchStats &stats) const { m_stats.addTo(stats); }
+
+  // Forget everything learned from previous searches
+  void clear() {
+    std::fill(&m_stepKillers[0][0], &m_stepKillers[0][0] + MAX_PLY * 2,
+              NO_SQUARE);
+    std::fill(&m_arrowKillers[0][0], &m_arrowKillers[0][0] + MAX_PLY * 2,
+              NO_SQUARE);
+    std::fill(&m_stepHistory[0][0], &m_stepHistory[0][0] + 2 * G::SQUARES,
+              0);
+    std::fill(&m_arrowHistory[0][0][0],
+              &m_arrowHistory[0][0][0] + 2 * G::SQUARES * G::SQUARES, 0);
+    m_walks.clear();
+  }
+
+  // Iterative deepening until maxDepth, a decided outcome or the stop signal.
+  // `moves` are the root moves and `first` the move to try first at depth one
+  void iterate(const GameState &root, const MoveList &moves, Move first,
+               int maxDepth) {
+    m_nodes = 0;
+    m_flushedNodes = 0;
+    m_nextPoll = CLOCK_STRIDE;
+    m_bestMove = first;
+    m_score = 0;
+    m_depth = 0;
+    ageHistory();
+    m_stats.start(m_id, m_shared.start);
+
+    m_walks.setTablebase(m_shared.tablebase);
+    if (m_shared.network) {
+      m_shared.network->refresh(root, m_accumulators[0]);
+    }
+    GameState state = root;
+    int stableIterations = 0;
+
+    // Helpers start half of them one depth deeper to spread the threads out
+    for (int depth = 1 + (isMain() ? 0 : m_id % 2); depth <= maxDepth;
+         ++depth) {
+      Move best = m_bestMove;
+      m_stats.startIteration(depth);
+      Score score = searchIteration(state, moves, depth, best);
+      m_stats.endIteration(depth, m_nodes);
+      if (stopped()) {
+        break;
+      }
+
+      stableIterations = m_depth > 0 && best == m_bestMove
+                             ? stableIterations + 1
+                             : 0;
+      m_bestMove = best;
+      m_score = score;
+      m_depth = depth;
+      CanonicalKey key = canonicalKey(state, m_shared.symmetries);
+      m_shared.tt.store(key.key, transformMove<G>(key.symmetry, best),
+                        scoreToTT(score, 0), depth, Bound::Exact);
+
+      // The outcome is already decided, deeper iterations can't change it
+      if (isWinScore(score)) {
+        break;
+      }
+      if (isMain() && pastSoftTime(stableIterations)) {
+        m_shared.stop.store(true, std::memory_order_relaxed);
+        break;
+      }
+    }
+
+    flushNodes();
+  }
+
+private:
+  bool stopped() const {
+    return m_shared.stop.load(std::memory_order_relaxed);
+  }
+
+  void flushNodes() {
+    m_shared.nodes.fetch_add(m_nodes - m_flushedNodes,
+                             std::memory_order_relaxed);
+    m_flushedNodes = m_nodes;
+  }
+
+  // Every thread looks at the clock, so the search still stops in time
+  // when there are more threads than cores and the main thread isn't
+  // running. Leaves bump m_nodes without polling, so the stride is counted
+  // from the last look rather than by multiples of it
+  bool pollStop() {
+    if (m_nodes >= m_nextPoll) {
+      m_nextPoll = m_nodes + CLOCK_STRIDE;
+      flushNodes();
+      if (shouldStop()) {
+        m_shared.stop.store(true, std::memory_order_relaxed);
+      }
+    }
+    return stopped();
+  }
+
+  // The next iteration takes several times as long as the last one, so once
+  // the best move has settled it is rarely worth starting
+  bool pastSoftTime(int stableIterations) const {
+    if (m_shared.softTime.count() <= 0) {
+      return false;
+    }
+    int percent = STABLE_TIME_PERCENT[std::min<std::size_t>(
+        stableIterations, std::size(STABLE_TIME_PERCENT) - 1)];
+    return Clock::now() - m_shared.start >= m_shared.softTime * percent / 100;
+  }
+
+  bool shouldStop() const {
+    if (m_shared.maxNodes != 0 &&
+        m_shared.nodes.load(std::memory_order_relaxed) >= m_shared.maxNodes) {
+      return true;
+    }
+    return m_shared.hasDeadline && Clock::now() >= m_shared.deadline;
+  }
+
+  void ageHistory() {
+    for (int &h : std::span(&m_stepHistory[0][0], 2 * G::SQUARES)) {
+      h /= 2;
+    }
+    for (int &h : std::span(&m_arrowHistory[0][0][0],
+                            2 * G::SQUARES * G::SQUARES)) {
+      h /= 2;
+    }
+  }
+
+  void addHistory(int &h, int bonus) {
+    h += bonus;
+    if (h > HISTORY_LIMIT) {
+      ageHistory();
+    }
+  }
+
+  template <class Scored>
+  static auto nextBest(Scored *scored, std::size_t size, std::size_t i) {
+    auto byScore = [](const Scored &a, const Scored &b) {
+      return a.score > b.score;
+    };
+
+    if (i < LAZY_PICKS) {
+      std::swap(scored[i],
+                *std::min_element(scored + i, scored + size, byScore));
+    } else if (i == LAZY_PICKS) {
+      std::sort(scored + i, scored + size, byScore);
+    }
+    return scored[i];
+  }
+
+  // Turns taken off the `index`th arrow of a node with `depth` turns left.
+  // Arrows far down the list lose two turns when there is depth to spare
+  int lateMoveReduction(int depth, std::size_t index) const {
+    const SearchOptions &options = m_shared.options;
+    std::size_t late = options.lateMoveArrows;
+    if (!options.lateMoveReductions || depth < 2 || index < late) {
+      return 0;
+    }
+    return depth >= 4 && index >= 4 * late ? 2 : 1;
+  }
+
+  // Derive the accumulator after the step or the arrow of turn `ply` from
+  // the one before it, when there is a network to use them
+  void accumulateStep(int ply, int side, Square from, Square to) {
+    if (m_shared.network) {
+      m_shared.network->step(m_accumulators[2 * ply],
+                             m_accumulators[2 * ply + 1], side, from, to);
+    }
+  }
+
+  void accumulateArrow(int ply, Square arrow) {
+    if (m_shared.network) {
+      m_shared.network->arrow(m_accumulators[2 * ply + 1],
+                              m_accumulators[2 * ply + 2], arrow);
+    }
+  }
+
+  Score evaluate(const GameState &state, int ply) const {
+    if (m_shared.network) {
+      return m_shared.network->evaluate(m_accumulators[2 * ply],
+                                        state.sideToMove());
+    }
+    return m_shared.eval(state);
+  }
+
+  int killerScore(const Square (&killers)[2], Square sq) const {
+    if (sq == killers[0]) {
+      return KILLER_BONUS + 1;
+    }
+    return sq == killers[1] ? KILLER_BONUS : 0;
+  }
+
+  void storeKiller(Square (&killers)[2], Square sq) {
+    if (sq != killers[0]) {
+      killers[1] = killers[0];
+      killers[0] = sq;
+    }
+  }
+
+  // One iteration, through as many aspiration windows as it takes
+  Score searchIteration(GameState &state, const MoveList &moves, int depth,
+                        Move &best) {
+    const SearchOptions &options = m_shared.options;
+    Score window = options.aspirationWindow;
+    Score alpha = -SCORE_INFINITE;
+    Score beta = SCORE_INFINITE;
+    if (options.aspirationDepth > 0 && depth >= options.aspirationDepth &&
+        m_depth > 0 && !isWinScore(m_score)) {
+      alpha = m_score - window;
+      beta = m_score + window;
+    }
+
+    for (;;) {
+      Score score = searchRoot(state, moves, depth, best, alpha, beta);
+      if (stopped()) {
+        return score;
+      }
+      if (score <= alpha && alpha > -SCORE_INFINITE) {
+        alpha = std::max<Score>(alpha - window, -SCORE_INFINITE);
+      } else if (score >= beta && beta < SCORE_INFINITE) {
+        beta = std::min<Score>(beta + window, SCORE_INFINITE);
+      } else {
+        return score;
+      }
+      window *= 2;
+    }
+  }
+
+  // Returns alpha when no move beats it, and the move's score as soon as one
+  // reaches beta
+  Score searchRoot(GameState &state, const MoveList &moves, int depth,
+                   Move &best, Score alpha, Score beta) {
+    int side = state.sideToMove();
+
+    // Try the best move of the previous iteration first
+    ScoredMove scored[MAX_MOVES<G>];
+    for (std::size_t i = 0; i < moves.size(); ++i) {
+      Move move = moves[i];
+      int score = m_stepHistory[side][move.to];
+      if (move.arrow != NO_SQUARE) {
+        score += m_arrowHistory[side][move.to][move.arrow];
+      }
+      scored[i] = {move, move == best ? PREVIOUS_BEST_BONUS : score};
+    }
+
+    bool pvs = m_shared.options.pvs;
+    for (std::size_t i = 0; i < moves.size(); ++i) {
+      Move move = nextBest(scored, moves.size(), i).move;
+
+      accumulateStep(0, side, move.from, move.to);
+      accumulateArrow(0, move.arrow);
+      state.makeMove(move);
+      Score score;
+      if (i == 0 || !pvs) {
+        score = -searchStep(state, depth - 1, 1, -beta, -alpha);
+      } else {
+        score = -searchStep(state, depth - 1, 1, -alpha - 1, -alpha);
+        if (score > alpha && score < beta) {
+          score = -searchStep(state, depth - 1, 1, -beta, -alpha);
+        }
+      }
+      state.unmakeMove(move);
+
+      if (stopped()) {
+        break;
+      }
+      if (score > alpha) {
+        alpha = score;
+        best = move;
+        if (alpha >= beta) {
+          break;
+        }
+      }
+    }
+    return alpha;
+  }
+
+  // First half of a turn: the side to move picks where to step
+  Score searchStep(GameState &state, int depth, int ply, Score alpha,
+                   Score beta) {
+    ++m_nodes;
+    m_stats.node(ply);
+
+    if (state.isGameOver()) {
+      return -(SCORE_WIN - ply);
+    }
+    if (m_shared.options.solvePartitions) {
+      int limit = m_shared.options.partitionSolveCells;
+      Partition<G> partition =
+          m_stats.timePartition([&] { return findPartition(state); });
+      auto solvable = [&](int player) {
+        Bitboard region = partition.regions[player];
+        return popCount(region) <= limit ||
+               m_walks.inTablebase(state.player(player), region);
+      };
+      if (partition.separated && solvable(0) && solvable(1)) {
+        m_stats.partitionSolved();
+        return m_walks.score(state, partition, ply);
+      }
+    }
+    if (depth <= 0 || ply >= MAX_PLY) {
+      return m_stats.timeEval([&] { return evaluate(state, ply); });
+    }
+    if (pollStop()) {
+      return 0;
+    }
+
+    int side = state.sideToMove();
+    Square from = state.player(side);
+    Bitboard free = state.free();
+    CanonicalKey key = canonicalKey(state, m_shared.symmetries);
+
+    TTData tt;
+    Move hashMove = NULL_MOVE;
+    bool hit = m_shared.tt.probe(key.key, tt);
+    m_stats.ttProbe(ply, hit);
+    if (hit) {
+      hashMove = untransformMove<G>(key.symmetry, tt.move);
+      Score score = scoreFromTT(tt.score, ply);
+      if (tt.depth >= depth &&
+          (tt.bound == Bound::Exact ||
+           (tt.bound == Bound::Lower && score >= beta) ||
+           (tt.bound == Bound::Upper && score <= alpha))) {
+        m_stats.ttCutoff(ply);
+        return score;
+      }
+    }
+
+    // Unknown steps go towards the most open squares first
+    ScoredSquare scored[8];
+    std::size_t count = 0;
+    for (Bitboard steps = state.stepTargets(); steps; ++count) {
+      Square to = popLowest(steps);
+      int score = killerScore(m_stepKillers[ply], to);
+      if (to == hashMove.to && from == hashMove.from) {
+        score = HASH_MOVE_BONUS;
+      } else if (score == 0) {
+        score = m_stepHistory[side][to] * 16 + G::mobility(to, free);
+      }
+      scored[count] = {to, score};
+    }
+
+    Score alphaOrig = alpha;
+    Score best = -SCORE_INFINITE;
+    Move bestMove = NULL_MOVE;
+    for (std::size_t i = 0; i < count; ++i) {
+      Square to = nextBest(scored, count, i).sq;
+      Square hashArrow = to == hashMove.to ? hashMove.arrow : NO_SQUARE;
+      Square arrow = NO_SQUARE;
+
+      accumulateStep(ply, side, from, to);
+      state.makeStep(to);
+      Score score;
+      if (i == 0 || !m_shared.options.pvs) {
+        score = searchArrow(state, depth, ply, alpha, beta, hashArrow, arrow);
+      } else {
+        score =
+            searchArrow(state, depth, ply, alpha, alpha + 1, hashArrow, arrow);
+        if (score > alpha && score < beta) {
+          score =
+              searchArrow(state, depth, ply, alpha, beta, hashArrow, arrow);
+        }
+      }
+      state.unmakeStep(from);
+
+      if (stopped()) {
+        return 0;
+      }
+      if (score > best) {
+        best = score;
+        bestMove = {.from = static_cast<std::int8_t>(from),
+                    .to = static_cast<std::int8_t>(to),
+                    .arrow = static_cast<std::int8_t>(arrow)};
+        if (score > alpha) {
+          alpha = score;
+          if (alpha >= beta) {
+            m_stats.cutoff(ply, i == 0);
+            storeKiller(m_stepKillers[ply], to);
+            addHistory(m_stepHistory[side][to], depth * depth);
+            break;
+          }
+        }
+      }
+    }
+
+    Bound bound = best >= beta       ? Bound::Lower
+                  : best > alphaOrig ? Bound::Exact
+                                     : Bound::Upper;
+    m_shared.tt.store(key.key, transformMove<G>(key.symmetry, bestMove),
+                      scoreToTT(best, ply), depth, bound);
+    return best;
+  }
+
+  // Second half of a turn: the side to move has stepped and picks an arrow.
+  // The side doesn't change between the halves, so there is no negation here.
+  // Leaves the arrow of the best line in bestArrow
+  Score searchArrow(GameState &state, int depth, int ply, Score alpha,
+                    Score beta, Square hashArrow, Square &bestArrow) {
+    ++m_nodes;
+    m_stats.node(ply);
+
+    int side = state.sideToMove();
+    Square to = state.player(side);
+
+    Bitboard arrows = arrowCandidates(state, m_shared.options);
+    if (!arrows) {
+      accumulateArrow(ply, NO_SQUARE);
+      state.makeArrow(NO_SQUARE);
+      Score score = -searchStep(state, depth - 1, ply + 1, -beta, -alpha);
+      state.unmakeArrow(NO_SQUARE);
+      return score;
+    }
+
+    // Unknown arrows go next to the opponent first
+    Bitboard opponentNeighbors = G::neighbors(state.player(side ^ 1));
+    ScoredSquare scored[G::SQUARES];
+    std::size_t count = 0;
+    for (; arrows; ++count) {
+      Square arrow = popLowest(arrows);
+      int score = killerScore(m_arrowKillers[ply], arrow);
+      if (arrow == hashArrow) {
+        score = HASH_MOVE_BONUS;
+      } else if (score == 0) {
+        score = m_arrowHistory[side][to][arrow] * 2 +
+                ((opponentNeighbors & G::squareBit(arrow)) != 0);
+      }
+      scored[count] = {arrow, score};
+    }
+
+    Score best = -SCORE_INFINITE;
+    for (std::size_t i = 0; i < count; ++i) {
+      Square arrow = nextBest(scored, count, i).sq;
+
+      accumulateArrow(ply, arrow);
+      state.makeArrow(arrow);
+      Score score;
+      if (i == 0) {
+        score = -searchStep(state, depth - 1, ply + 1, -beta, -alpha);
+      } else {
+        // Without PVS a reduced arrow is still verified, with a full window
+        Score nullBeta = m_shared.options.pvs ? alpha + 1 : beta;
+        int reduction = lateMoveReduction(depth, i);
+        score = -searchStep(state, depth - 1 - reduction, ply + 1, -nullBeta,
+                            -alpha);
+        if (reduction > 0 && score > alpha) {
+          score = -searchStep(state, depth - 1, ply + 1, -nullBeta, -alpha);
+        }
+        if (score > alpha && score < beta && nullBeta < beta) {
+          score = -searchStep(state, depth - 1, ply + 1, -beta, -alpha);
+        }
+      }
+      state.unmakeArrow(arrow);
+
+      if (stopped()) {
+        return 0;
+      }
+      if (score > best) {
+        best = score;
+        bestArrow = arrow;
+        if (score > alpha) {
+          alpha = score;
+          if (alpha >= beta) {
+            m_stats.cutoff(ply, i == 0);
+            storeKiller(m_arrowKillers[ply], arrow);
+            addHistory(m_arrowHistory[side][to][arrow], depth * depth);
+            break;
+          }
+        }
+      }
+    }
+    return best;
+  }
+};
+
+template <class G> class BasicEngine {
+  using Bitboard = typename G::Bitboard;
+  using GameState = BasicGameState<G>;
+  using MoveList = BasicMoveList<G>;
+  using Clock = std::chrono::steady_clock;
+
+  SearchShared<G> m_shared;
+  std::vector<std::unique_ptr<SearchWorker<G>>> m_workers;
+  const OpeningBook<G> *m_book = nullptr;
+  SearchStats m_stats;
+
+public:
+  explicit BasicEngine(BasicEvaluator<G> eval = evalVoronoi<G>,
+                       SearchOptions options = {}) {
+    m_shared.eval = eval;
+    m_shared.options = options;
+    m_workers.push_back(std::make_unique<SearchWorker<G>>(0, m_shared));
+  }
+
+  void setEvaluator(BasicEvaluator<G> eval) { m_shared.eval = eval; }
+  void setHashSize(std::size_t megabytes) { m_shared.tt.resize(megabytes); }
+  void setOptions(const SearchOptions &options) { m_shared.options = options; }
+  const SearchOptions &options() const { return m_shared.options; }
+  // The book has to outlive every search that uses it, nullptr turns it off
+  void setBook(const OpeningBook<G> *book) { m_book = book; }
+  // Same for the endgame tablebase
+  void setTablebase(const Tablebase *tablebase) {
+    m_shared.tablebase = tablebase;
+  }
+  // And for the network, which evaluates instead of the evaluator while set
+  void setNetwork(const BasicNetwork<G> *network) {
+    m_shared.network = network;
+  }
+
+  // Forget everything learned from previous searches
+  void clear() {
+    for (auto &worker : m_workers) {
+      worker->clear();
+    }
+    m_shared.tt.clear();
+  }
+
+  // Asks a running search to return as soon as possible, safe to call from
+  // any thread
+  void stop() { m_shared.stop.store(true, std::memory_order_relaxed); }
+
+  // What the threads of the last search counted, always empty without
+  // ISOLA_STATS
+  const SearchStats &stats() const { return m_stats; }
+
+  SearchResult search(const GameState &root, const SearchLimits &limits,
+                      int threads = 1) {
+    Clock::time_point start = Clock::now();
+
+    threads = std::max(threads, 1);
+    while (m_workers.size() < static_cast<std::size_t>(threads)) {
+      m_workers.push_back(
+          std::make_unique<SearchWorker<G>>(m_workers.size(), m_shared));
+    }
+
+    m_shared.stop.store(false, std::memory_order_relaxed);
+    m_shared.nodes.store(0, std::memory_order_relaxed);
+    m_shared.maxNodes = limits.maxNodes;
+    m_shared.hasDeadline = limits.moveTime.count() > 0;
+    m_shared.start = start;
+    m_shared.deadline = start + limits.moveTime;
+    m_shared.softTime = limits.softTime;
+    m_shared.tt.newSearch();
+    m_shared.symmetries =
+        m_shared.options.canonicalHashing ? positionSymmetries(root) : 0;
+    if constexpr (STATS_ENABLED) {
+      m_stats.clear();
+    }
+
+    SearchResult result;
+    result.threads = threads;
+
+    MoveList moves;
+    generateRootMoves(root, moves);
+    if (moves.empty()) {
+      result.score = -SCORE_WIN;
+      return result;
+    }
+
+    BookEntry entry;
+    if (m_book && m_book->probe(root, entry) && root.isLegal(entry.move())) {
+      result.bestMove = entry.move();
+      result.score = entry.score;
+      result.depth = entry.depth;
+      result.fromBook = true;
+      result.ponderMove = expectedReply(root, result.bestMove);
+      result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+          Clock::now() - start);
+      return result;
+    }
+
+    // Always have something to play, even if the first iteration is cut short
+    result.bestMove = moves[0];
+    TTData tt;
+    CanonicalKey key = canonicalKey(root, m_shared.symmetries);
+    if (m_shared.tt.probe(key.key, tt) &&
+        std::find(moves.begin(), moves.end(),
+                  untransformMove<G>(key.symmetry, tt.move)) != moves.end()) {
+      result.bestMove = untransformMove<G>(key.symmetry, tt.move);
+    }
+
+    if (moves.size() > 1) {
+      int maxDepth = std::clamp(limits.maxDepth, 1, MAX_PLY);
+
+      std::vector<std::jthread> helpers;
+      for (int i = 1; i < threads; ++i) {
+        helpers.emplace_back([&, i] {
+          m_workers[i]->iterate(root, moves, result.bestMove, maxDepth);
+        });
+      }
+
+      m_workers[0]->iterate(root, moves, result.bestMove, maxDepth);
+      stop();
+      helpers.clear();
+
+      if constexpr (STATS_ENABLED) {
+        for (int i = 0; i < threads; ++i) {
+          m_workers[i]->addStats(m_stats);
+        }
+      }
+
+      // A helper may have finished a deeper iteration than the main thread
+      SearchWorker<G> *best = m_workers[0].get();
+      for (int i = 1; i < threads; ++i) {
+        if (m_workers[i]->depth() > best->depth()) {
+          best = m_workers[i].get();
+        }
+      }
+      if (best->depth() > 0) {
+        result.bestMove = best->bestMove();
+        result.score = best->score();
+        result.depth = best->depth();
+      }
+    }
+
+    result.ponderMove = expectedReply(root, result.bestMove);
+    result.nodes = m_shared.nodes.load(std::memory_order_relaxed);
+    result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start);
+    return result;
+  }
+
+  // The line the last searches expect from `root`: `first`, then the book's
+  // or the table's move in every position after it for as long as there is
+  // a legal one, at most `maxLength` moves
+  std::vector<Move> principalVariation(GameState root, Move first,
+                                       int maxLength = MAX_PLY) const {
+    std::vector<Move> line;
+    for (Move move = first; static_cast<int>(line.size()) < maxLength &&
+                            move != NULL_MOVE && root.isLegal(move);
+         move = expectedMove(root)) {
+      line.push_back(move);
+      root.makeMove(move);
+    }
+    return line;
+  }
+
+private:
+  // The book's or else the table's move after `move`, if it is legal there
+  Move expectedReply(GameState state, Move move) const {
+    state.makeMove(move);
+    return expectedMove(state);
+  }
+
+  // The book's or else the table's move in `state`, if it is legal there
+  Move expectedMove(const GameState &state) const {
+    if (state.isGameOver()) {
+      return NULL_MOVE;
+    }
+
+    BookEntry entry;
+    if (m_book && m_book->probe(state, entry) && state.isLegal(entry.move())) {
+      return entry.move();
+    }
+    TTData tt;
+    CanonicalKey key = canonicalKey(state, m_shared.symmetries);
+    if (m_shared.tt.probe(key.key, tt)) {
+      Move reply = untransformMove<G>(key.symmetry, tt.move);
+      if (state.isLegal(reply)) {
+        return reply;
+      }
+    }
+    return NULL_MOVE;
+  }
+
+  // Every step with its candidate arrows, in generation order
+  void generateRootMoves(GameState state, MoveList &moves) const {
+    moves.clear();
+
+    Square from = state.player(state.sideToMove());
+    for (Bitboard steps = state.stepTargets(); steps;) {
+      Square to = popLowest(steps);
+      state.makeStep(to);
+
+      Move move{.from = static_cast<std::int8_t>(from),
+                .to = static_cast<std::int8_t>(to),
+                .arrow = NO_SQUARE};
+      Bitboard arrows = arrowCandidates(state, m_shared.options);
+      if (!arrows) {
+        moves.push_back(move);
+      }
+      while (arrows) {
+        move.arrow = static_cast<std::int8_t>(popLowest(arrows));
+        moves.push_back(move);
+      }
+
+      state.unmakeStep(from);
+    }
+  }
+};
+
+using Engine = BasicEngine<DefaultGeometry>;
+
+} // namespace isola
@@ -0,0 +1,378 @@
+/*
+    clang-format off
+
+    isola_selfplay: plays many games at once to generate training and balance
+    data.
+
+        isola_selfplay [--games <n>] [--threads <n>] [--out <file>]
+                       [--p1 engine|mcts|random] [--p2 engine|mcts|random]
+                       [--movetime <ms>] [--depth <n>] [--nodes <n>]
+                       [--hash <mb>] [--random-plies <n>] [--seed <n>]
+                       [--text] [--size <rows>x<cols>]
+
+    mcts sides use --hash as the size of their node pool and count --nodes
+    in playouts; without --movetime or --nodes they stop at a fixed number of
+    playouts instead of a depth.
+
+    Games are handed out to a fixed pool of threads. Every thread owns an arena
+    with everything a game needs (engines, move record, output buffer), all set
+    up before the first game starts, so playing a game never allocates. Each
+    finished game goes into the thread's buffer as a binary GameRecord (see
+    record.hpp), and full buffers go to the output file in large chunks.
+    Games land in the file in the order they finish, not by index.
+
+    --text writes a readable line per game instead
+
+        <game> <winner B|W> <turns> <move> <move> ...
+
+    which is handy for looking at a few games but far too big for datasets.
+
+    --size plays on another board than the standard 7x7, the record file
+    header says which.
+    The first --random-plies turns of each game are random so engine games
+    don't all repeat the same opening. Random choices are seeded per game, so
+    a game's random moves don't depend on which thread played it.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "game_state.hpp"
+#include "mcts.hpp"
+#include "notation.hpp"
+#include "record.hpp"
+#include "search.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Policy { Engine, Mcts, Random };
+
+struct Config {
+  isola::BoardSize size{isola::DefaultGeometry::ROWS,
+                        isola::DefaultGeometry::COLS};
+  std::uint64_t games = 1000;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  bool text = false;
+  const char *out = nullptr;
+  Policy policies[2] = {Policy::Engine, Policy::Engine};
+  isola::SearchLimits limits{.moveTime = std::chrono::milliseconds{0},
+                             .maxDepth = 4};
+  std::size_t hashMB = 4;
+  int randomPlies = 2;
+  std::uint64_t seed = 1;
+};
+
+struct Totals {
+  std::atomic<std::uint64_t> games{0};
+  std::atomic<std::uint64_t> turns{0};
+  std::atomic<std::uint64_t> wins[2] = {0, 0};
+};
+
+// Takes buffered chunks of games from the workers, either binary records or
+// text, depending on how it was opened
+template <class G> class Output {
+  std::unique_ptr<isola::RecordWriter<G>> m_records;
+  std::FILE *m_text = nullptr;
+  std::mutex m_mutex;
+
+public:
+  Output(const char *path, bool text) {
+    if (text) {
+      m_text = std::fopen(path, "wb");
+    } else {
+      m_records = std::make_unique<isola::RecordWriter<G>>(path);
+    }
+  }
+
+  ~Output() { close(); }
+
+  bool ok() const { return m_text || (m_records && m_records->ok()); }
+
+  void write(const char *data, std::size_t size) {
+    std::lock_guard lock(m_mutex);
+    std::fwrite(data, 1, size, m_text);
+  }
+
+  void write(const isola::BasicGameRecord<G> *records, std::size_t count) {
+    std::lock_guard lock(m_mutex);
+    m_records->append(records, count);
+  }
+
+  bool close() {
+    bool ok = true;
+    if (m_text) {
+      ok = std::fclose(m_text) == 0;
+      m_text = nullptr;
+    }
+    if (m_records) {
+      ok = m_records->close();
+    }
+    return ok;
+  }
+};
+
+// Everything one thread needs to play games back to back
+template <class G> class SelfPlayWorker {
+  static constexpr std::size_t BUFFER_SIZE = 1 << 16;
+  static constexpr std::size_t BUFFER_RECORDS =
+      BUFFER_SIZE / isola::RECORD_SIZE<G>;
+  // Index, winner, length and every move of the longest game
+  static constexpr std::size_t MAX_LINE =
+      64 + isola::MAX_GAME_TURNS<G> * isola::MOVE_TEXT_SIZE;
+
+  const Config &m_config;
+  Output<G> &m_output;
+  Totals &m_totals;
+
+  std::unique_ptr<isola::BasicEngine<G>> m_engines[2];
+  std::unique_ptr<isola::BasicMctsEngine<G>> m_mcts[2];
+  isola::Move m_moves[isola::MAX_GAME_TURNS<G>];
+  // Only the one for the output format is allocated
+  std::unique_ptr<char[]> m_text;
+  std::unique_ptr<isola::BasicGameRecord<G>[]> m_records;
+  std::size_t m_used = 0;
+
+public:
+  SelfPlayWorker(const Config &config, Output<G> &output, Totals &totals)
+      : m_config(config), m_output(output), m_totals(totals) {
+    if (config.text) {
+      m_text.reset(new char[BUFFER_SIZE]);
+    } else {
+      m_records.reset(new isola::BasicGameRecord<G>[BUFFER_RECORDS]);
+    }
+    for (int side = 0; side < 2; ++side) {
+      if (config.policies[side] == Policy::Engine) {
+        m_engines[side] = std::make_unique<isola::BasicEngine<G>>();
+        m_engines[side]->setHashSize(config.hashMB);
+      } else if (config.policies[side] == Policy::Mcts) {
+        m_mcts[side] =
+            std::make_unique<isola::BasicMctsEngine<G>>(isola::MctsOptions{},
+                                                        config.hashMB);
+      }
+    }
+  }
+
+  ~SelfPlayWorker() { flush(); }
+
+  void play(std::uint64_t game) {
+    std::mt19937_64 rng(m_config.seed ^ (game * 0x9e3779b97f4a7c15));
+
+    isola::BasicGameState<G> state;
+    isola::BasicMoveList<G> moves;
+    int turns = 0;
+    while (!state.isGameOver()) {
+      int side = state.sideToMove();
+      isola::Move move;
+      if (turns < m_config.randomPlies ||
+          m_config.policies[side] == Policy::Random) {
+        state.generateMoves(moves);
+        move = moves[rng() % moves.size()];
+      } else if (m_config.policies[side] == Policy::Mcts) {
+        move = m_mcts[side]->search(state, m_config.limits).bestMove;
+      } else {
+        move = m_engines[side]->search(state, m_config.limits).bestMove;
+      }
+
+      state.makeMove(move);
+      m_moves[turns++] = move;
+    }
+
+    record(game, state.winner(), turns);
+  }
+
+private:
+  void record(std::uint64_t game, int winner, int turns) {
+    if (m_config.text) {
+      recordText(game, winner, turns);
+    } else {
+      if (m_used == BUFFER_RECORDS) {
+        flush();
+      }
+      m_records[m_used++] = isola::makeRecord<G>(m_moves, turns, winner);
+    }
+
+    m_totals.games.fetch_add(1, std::memory_order_relaxed);
+    m_totals.turns.fetch_add(turns, std::memory_order_relaxed);
+    m_totals.wins[winner].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void recordText(std::uint64_t game, int winner, int turns) {
+    if (BUFFER_SIZE - m_used < MAX_LINE) {
+      flush();
+    }
+
+    char *out = m_text.get() + m_used;
+    out += std::snprintf(out, 64, "%llu %s %d",
+                         static_cast<unsigned long long>(game),
+                         winner == 0 ? isola::PLAYER_ONE : isola::PLAYER_TWO,
+                         turns);
+    for (int i = 0; i < turns; ++i) {
+      *out++ = ' ';
+      out = isola::formatMove<G>(m_moves[i], out);
+    }
+    *out++ = '\n';
+    m_used = out - m_text.get();
+  }
+
+  void flush() {
+    if (m_used == 0) {
+      return;
+    }
+    if (m_config.text) {
+      m_output.write(m_text.get(), m_used);
+    } else {
+      m_output.write(m_records.get(), m_used);
+    }
+    m_used = 0;
+  }
+};
+
+std::optional<Policy> parsePolicy(std::string_view name) {
+  if (name == "engine") {
+    return Policy::Engine;
+  } else if (name == "mcts") {
+    return Policy::Mcts;
+  } else if (name == "random") {
+    return Policy::Random;
+  }
+  return std::nullopt;
+}
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg{argv[i]};
+    if (arg == "--text") {
+      config.text = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+
+    if (arg == "--games") {
+      config.games = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--threads") {
+      config.threads = std::max(1, std::atoi(value));
+    } else if (arg == "--out") {
+      config.out = value;
+    } else if (arg == "--p1" || arg == "--p2") {
+      auto policy = parsePolicy(value);
+      if (!policy) {
+        return false;
+      }
+      config.policies[arg == "--p1" ? 0 : 1] = *policy;
+    } else if (arg == "--movetime") {
+      config.limits.moveTime = std::chrono::milliseconds{std::atoi(value)};
+      config.limits.maxDepth = isola::MAX_PLY;
+    } else if (arg == "--depth") {
+      config.limits.maxDepth = std::atoi(value);
+    } else if (arg == "--nodes") {
+      config.limits.maxNodes = std::strtoull(value, nullptr, 10);
+      config.limits.maxDepth = isola::MAX_PLY;
+    } else if (arg == "--hash") {
+      config.hashMB = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--random-plies") {
+      config.randomPlies = std::atoi(value);
+    } else if (arg == "--seed") {
+      config.seed = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--size") {
+      auto size = isola::parseBoardSize(value);
+      if (!size) {
+        return false;
+      }
+      config.size = *size;
+    } else {
+      return false;
+    }
+  }
+  if (!config.out) {
+    config.out = config.text ? "selfplay.txt" : "selfplay.igr";
+  }
+  return true;
+}
+
+template <class G> int run(const Config &config) {
+  Output<G> output(config.out, config.text);
+  if (!output.ok()) {
+    std::perror(config.out);
+    return EXIT_FAILURE;
+  }
+
+  Totals totals;
+  std::atomic<std::uint64_t> nextGame{0};
+  Clock::time_point start = Clock::now();
+
+  {
+    std::vector<std::jthread> pool;
+    for (int i = 0; i < config.threads; ++i) {
+      pool.emplace_back([&] {
+        SelfPlayWorker<G> worker(config, output, totals);
+        for (std::uint64_t game = nextGame.fetch_add(1);
+             game < config.games; game = nextGame.fetch_add(1)) {
+          worker.play(game);
+        }
+      });
+    }
+  }
+
+  if (!output.close()) {
+    std::perror(config.out);
+    return EXIT_FAILURE;
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::uint64_t games = totals.games.load();
+  std::fprintf(stderr,
+               "%llu games in %.2f s (%.1f games/s), %s won %llu, %s won "
+               "%llu, %.1f turns per game\n",
+               static_cast<unsigned long long>(games), seconds,
+               seconds > 0 ? games / seconds : 0.0, isola::PLAYER_ONE,
+               static_cast<unsigned long long>(totals.wins[0].load()),
+               isola::PLAYER_TWO,
+               static_cast<unsigned long long>(totals.wins[1].load()),
+               games > 0 ? static_cast<double>(totals.turns.load()) / games
+                         : 0.0);
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr,
+                 "Usage: %s [--games <n>] [--threads <n>] [--out <file>]\n"
+                 "       [--p1 engine|mcts|random] [--p2 engine|mcts|random]\n"
+                 "       [--movetime <ms>] [--depth <n>] [--nodes <n>]\n"
+                 "       [--hash <mb>] [--random-plies <n>] [--seed <n>]\n"
+                 "       [--text] [--size <rows>x<cols>]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_FAILURE;
+  if (!isola::dispatchGeometry(config.size,
+                               [&]<class G>() { status = run<G>(config); })) {
+    std::fprintf(stderr, "%dx%d boards are not supported\n", config.size.rows,
+                 config.size.cols);
+  }
+  return status;
+}
@@ -0,0 +1,715 @@
+/*
+    clang-format off
+
+    isola_server: answers search requests for many games at once over TCP
+    or a Unix socket.
+
+        isola_server [--port <n>] [--host <ipv4>] [--unix <path>]
+                     [--workers <n>] [--hash <mb>] [--max-movetime <ms>]
+                     [--max-queue <n>]
+
+    It listens on 127.0.0.1:7711 by default, --port 0 turns TCP off. Clients
+    send one request per line and can have any number of them in flight on
+    a connection:
+
+        <id> <board> <B|W> <movetime>
+
+    <board> is the rows of the board joined by '/', in the symbols isola
+    draws it with (+ free, A dead, B and W the players), so its size comes
+    with it. B or W is the side to move and <movetime> the budget in
+    milliseconds, capped by --max-movetime. The budget counts from when the
+    request is read: time spent waiting for a worker is taken off the
+    search. Every request gets one line back once its search is done, in
+    whatever order the searches finish:
+
+        <id> bestmove <move> score <n> depth <n> nodes <n> time <ms> wait <ms>
+        <id> bestmove none          the side to move can't step
+        <id> error <reason>
+
+    One thread does all the socket I/O with epoll and the searches run on a
+    fixed pool of --workers threads (one per core by default), each with its
+    own engine and --hash MB table per board size. Requests read in the same
+    epoll round go into the queue under one lock, and a worker takes one at
+    a time, so a request never waits behind another one's search while a
+    worker is idle. Answers come back through an eventfd that is only
+    written when the I/O thread isn't already due to wake up. Past
+    --max-queue waiting requests new ones are answered with "error busy"
+    straight away.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "board.hpp"
+#include "game_state.hpp"
+#include "notation.hpp"
+#include "search.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+  int port = 7711;
+  const char *host = "127.0.0.1";
+  const char *unixPath = nullptr;
+  int workers = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t hashMB = 16;
+  std::chrono::milliseconds maxMoveTime{10000};
+  std::size_t maxQueue = 100000;
+};
+
+// A request line waiting for a worker
+struct Job {
+  std::uint64_t connection;
+  std::string line;
+  Clock::time_point received;
+};
+
+struct Reply {
+  std::uint64_t connection;
+  std::string text;
+};
+
+class JobQueue {
+  std::mutex m_mutex;
+  std::condition_variable m_ready;
+  std::deque<Job> m_jobs;
+  bool m_closed = false;
+
+public:
+
+  std::size_t size() {
+    std::lock_guard lock(m_mutex);
+    return m_jobs.size();
+  }
+
+  void push(std::vector<Job> &jobs) {
+    if (jobs.empty()) {
+      return;
+    }
+    {
+      std::lock_guard lock(m_mutex);
+      std::move(jobs.begin(), jobs.end(), std::back_inserter(m_jobs));
+    }
+    jobs.clear();
+    m_ready.notify_all();
+  }
+
+  // Waits for work and moves the oldest job to `out`, false once closed.
+  // One job per call: a search takes milliseconds, far longer than the lock,
+  // and a job held back by a worker would wait out a whole search
+  bool pop(Job &out) {
+    std::unique_lock lock(m_mutex);
+    m_ready.wait(lock, [&] { return m_closed || !m_jobs.empty(); });
+    if (m_closed) {
+      return false;
+    }
+    out = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    return true;
+  }
+
+  // Wakes every worker, jobs still waiting are dropped
+  void close() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_closed = true;
+    }
+    m_ready.notify_all();
+  }
+};
+
+class ReplyQueue {
+  std::mutex m_mutex;
+  std::vector<Reply> m_replies;
+  int m_wakeFd;
+
+public:
+  explicit ReplyQueue(int wakeFd) : m_wakeFd(wakeFd) {}
+
+  void push(Reply reply) {
+    bool wake;
+    {
+      std::lock_guard lock(m_mutex);
+      wake = m_replies.empty();
+      m_replies.push_back(std::move(reply));
+    }
+    // A non-empty queue already has a wake-up on the way
+    if (wake) {
+      std::uint64_t one = 1;
+      [[maybe_unused]] ssize_t written = ::write(m_wakeFd, &one, sizeof(one));
+    }
+  }
+
+  void take(std::vector<Reply> &out) {
+    std::lock_guard lock(m_mutex);
+    out.swap(m_replies);
+  }
+};
+
+// One engine per supported board size, made the first time a request needs
+// it
+template <class List> class EngineSet;
+
+template <class... Geometries>
+class EngineSet<isola::GeometryList<Geometries...>> {
+  std::tuple<std::unique_ptr<isola::BasicEngine<Geometries>>...> m_engines;
+  std::size_t m_hashMB;
+
+public:
+  explicit EngineSet(std::size_t hashMB) : m_hashMB(hashMB) {}
+
+  template <class G> isola::BasicEngine<G> &get() {
+    auto &engine = std::get<std::unique_ptr<isola::BasicEngine<G>>>(m_engines);
+    if (!engine) {
+      engine = std::make_unique<isola::BasicEngine<G>>();
+      engine->setHashSize(m_hashMB);
+    }
+    return *engine;
+  }
+};
+
+using Engines = EngineSet<isola::SupportedGeometries>;
+
+std::string errorReply(std::string_view id, const char *reason) {
+  std::string text{id.empty() ? "?" : id};
+  text += " error ";
+  text += reason;
+  text += '\n';
+  return text;
+}
+
+long long toMilliseconds(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+      .count();
+}
+
+template <class G>
+std::string search(Engines &engines, std::string_view id,
+                   std::string_view boardText, int side,
+                   std::chrono::milliseconds budget,
+                   Clock::time_point received) {
+  auto board = isola::BasicBoard<G>::fromString(boardText);
+  if (!board) {
+    return errorReply(id, "bad board");
+  }
+  isola::BasicGameState<G> state(*board, side);
+  // Made before the clock is read, so building the first engine of a board
+  // size counts as waiting and comes out of the budget
+  isola::BasicEngine<G> &engine = engines.get<G>();
+
+  Clock::time_point start = Clock::now();
+  Clock::duration wait = start - received;
+  isola::SearchLimits limits;
+  limits.moveTime =
+      std::max(std::chrono::duration_cast<std::chrono::milliseconds>(
+                   budget - wait),
+               std::chrono::milliseconds{1});
+  isola::SearchResult result = engine.search(state, limits);
+
+  std::string text{id};
+  if (result.bestMove == isola::NULL_MOVE) {
+    text += " bestmove none\n";
+    return text;
+  }
+  char move[isola::MOVE_TEXT_SIZE];
+  *isola::formatMove<G>(result.bestMove, move) = '\0';
+  char stats[160];
+  std::snprintf(stats, sizeof(stats),
+                " bestmove %s score %d depth %d nodes %llu time %lld wait "
+                "%lld\n",
+                move, result.score, result.depth,
+                static_cast<unsigned long long>(result.nodes),
+                toMilliseconds(Clock::now() - start), toMilliseconds(wait));
+  text += stats;
+  return text;
+}
+
+std::string answer(Engines &engines, const Job &job, const Config &config) {
+  std::string_view rest{job.line};
+  std::string_view id = isola::nextToken(rest);
+  std::string_view boardText = isola::nextToken(rest);
+  std::string_view sideText = isola::nextToken(rest);
+  std::string_view moveTimeText = isola::nextToken(rest);
+
+  int moveTime = 0;
+  auto [end, error] = std::from_chars(
+      moveTimeText.data(), moveTimeText.data() + moveTimeText.size(),
+      moveTime);
+  if (boardText.empty() || (sideText != isola::PLAYER_ONE &&
+                            sideText != isola::PLAYER_TWO) ||
+      error != std::errc{} || end != moveTimeText.data() + moveTimeText.size() ||
+      moveTime <= 0 || !isola::nextToken(rest).empty()) {
+    return errorReply(id, "usage: <id> <board> <B|W> <movetime>");
+  }
+  int side = sideText == isola::PLAYER_ONE ? 0 : 1;
+  std::chrono::milliseconds budget =
+      std::min(std::chrono::milliseconds{moveTime}, config.maxMoveTime);
+
+  int rows = std::count(boardText.begin(), boardText.end(), '/') + 1;
+  int cols = static_cast<int>(std::min(boardText.find('/'), boardText.size()));
+  std::string text;
+  if (!isola::dispatchGeometry(rows, cols, [&]<class G>() {
+        text = search<G>(engines, id, boardText, side, budget, job.received);
+      })) {
+    return errorReply(id, "unsupported board size");
+  }
+  return text;
+}
+
+void work(const Config &config, JobQueue &jobs, ReplyQueue &replies,
+          std::atomic<std::uint64_t> &served) {
+  Engines engines(config.hashMB);
+  // Most games are on the standard board, so its engine is ready before the
+  // first request rather than built out of that request's budget
+  engines.get<isola::DefaultGeometry>();
+  Job job;
+  while (jobs.pop(job)) {
+    replies.push({job.connection, answer(engines, job, config)});
+    served.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// All socket I/O, run on the main thread
+class Server {
+  // epoll tags below FIRST_CONNECTION, listeners are tagged by their index
+  static constexpr std::uint64_t WAKE = 8;
+  static constexpr std::uint64_t SIGNALS = 9;
+  static constexpr std::uint64_t FIRST_CONNECTION = 16;
+
+  // A request line longer than this closes its connection
+  static constexpr std::size_t MAX_LINE = 4096;
+
+  struct Connection {
+    int fd;
+    std::string in;
+    std::string out;
+    // Requests read and not answered yet
+    std::size_t pending = 0;
+    // Cleared once the client has stopped sending, the connection then
+    // stays open until all its answers are written
+    bool readable = true;
+    std::uint32_t events = EPOLLIN;
+  };
+
+  const Config &m_config;
+  JobQueue &m_jobs;
+  ReplyQueue &m_replies;
+  int m_epoll;
+  int m_wakeFd;
+  int m_signalFd;
+  std::vector<int> m_listeners;
+  std::unordered_map<std::uint64_t, Connection> m_connections;
+  std::uint64_t m_nextConnection = FIRST_CONNECTION;
+  // Read in the current epoll round, queued together at the end of it
+  std::vector<Job> m_batch;
+
+public:
+  Server(const Config &config, JobQueue &jobs, ReplyQueue &replies,
+         int wakeFd, int signalFd)
+      : m_config(config), m_jobs(jobs), m_replies(replies),
+        m_epoll(::epoll_create1(EPOLL_CLOEXEC)), m_wakeFd(wakeFd),
+        m_signalFd(signalFd) {}
+
+  ~Server() {
+    for (auto &[id, connection] : m_connections) {
+      ::close(connection.fd);
+    }
+    for (int fd : m_listeners) {
+      ::close(fd);
+    }
+    if (m_config.unixPath) {
+      ::unlink(m_config.unixPath);
+    }
+    ::close(m_epoll);
+  }
+
+  bool listen() {
+    if (m_epoll < 0 || !watch(m_wakeFd, WAKE, EPOLLIN) ||
+        !watch(m_signalFd, SIGNALS, EPOLLIN)) {
+      std::perror("epoll");
+      return false;
+    }
+    if (m_config.port > 0 && !listenTcp()) {
+      std::perror(m_config.host);
+      return false;
+    }
+    if (m_config.unixPath && !listenUnix()) {
+      std::perror(m_config.unixPath);
+      return false;
+    }
+    if (m_listeners.empty()) {
+      std::fprintf(stderr, "Nothing to listen on\n");
+      return false;
+    }
+    return true;
+  }
+
+  // Serves until SIGINT or SIGTERM
+  void run() {
+    epoll_event events[64];
+    for (;;) {
+      int count = ::epoll_wait(m_epoll, events, 64, -1);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::perror("epoll_wait");
+        return;
+      }
+
+      for (int i = 0; i < count; ++i) {
+        std::uint64_t tag = events[i].data.u64;
+        if (tag == SIGNALS) {
+          return;
+        } else if (tag == WAKE) {
+          deliverReplies();
+        } else if (tag < m_listeners.size()) {
+          accept(m_listeners[tag]);
+        } else {
+          serve(tag, events[i].events);
+        }
+      }
+      queueBatch();
+    }
+  }
+
+private:
+  bool watch(int fd, std::uint64_t tag, std::uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = tag;
+    return ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+  }
+
+  bool addListener(int fd, const sockaddr *address, socklen_t size) {
+    if (fd < 0) {
+      return false;
+    }
+    if (::bind(fd, address, size) != 0 || ::listen(fd, SOMAXCONN) != 0 ||
+        !watch(fd, m_listeners.size(), EPOLLIN)) {
+      ::close(fd);
+      return false;
+    }
+    m_listeners.push_back(fd);
+    return true;
+  }
+
+  bool listenTcp() {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(m_config.port));
+    if (::inet_pton(AF_INET, m_config.host, &address.sin_addr) != 1) {
+      errno = EINVAL;
+      return false;
+    }
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    if (fd >= 0) {
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (!addListener(fd, reinterpret_cast<const sockaddr *>(&address),
+                     sizeof(address))) {
+      return false;
+    }
+    std::fprintf(stderr, "Listening on %s:%d\n", m_config.host,
+                 m_config.port);
+    return true;
+  }
+
+  bool listenUnix() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(m_config.unixPath) >= sizeof(address.sun_path)) {
+      errno = ENAMETOOLONG;
+      return false;
+    }
+    std::strcpy(address.sun_path, m_config.unixPath);
+    // A socket file left behind by an earlier run would fail the bind
+    ::unlink(m_config.unixPath);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (!addListener(fd, reinterpret_cast<const sockaddr *>(&address),
+                     sizeof(address))) {
+      return false;
+    }
+    std::fprintf(stderr, "Listening on %s\n", m_config.unixPath);
+    return true;
+  }
+
+  void accept(int listener) {
+    for (;;) {
+      int fd = ::accept4(listener, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        return;
+      }
+      // Replies are short lines that shouldn't wait for more to send, this
+      // fails harmlessly on Unix sockets
+      int on = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+      std::uint64_t id = m_nextConnection++;
+      if (!watch(fd, id, EPOLLIN)) {
+        ::close(fd);
+        continue;
+      }
+      m_connections.emplace(id, Connection{.fd = fd});
+    }
+  }
+
+  void serve(std::uint64_t id, std::uint32_t events) {
+    auto found = m_connections.find(id);
+    if (found == m_connections.end()) {
+      return;
+    }
+    // A hang-up has both directions shut, so nothing could be answered.
+    // It is also reported whatever the event mask, so a connection kept open
+    // for its pending answers would wake epoll until they were all done
+    if (events & (EPOLLERR | EPOLLHUP)) {
+      close(found);
+    } else if (events & EPOLLIN) {
+      read(found);
+    } else {
+      update(found);
+    }
+  }
+
+  using ConnectionIt = decltype(m_connections)::iterator;
+
+  void read(ConnectionIt it) {
+    Connection &connection = it->second;
+    char buffer[16384];
+    for (;;) {
+      ssize_t size = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+      if (size > 0) {
+        connection.in.append(buffer, size);
+      } else if (size == 0) {
+        connection.readable = false;
+        break;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      } else {
+        close(it);
+        return;
+      }
+    }
+
+    Clock::time_point now = Clock::now();
+    std::size_t start = 0;
+    for (std::size_t end; (end = connection.in.find('\n', start)) !=
+                          std::string::npos;
+         start = end + 1) {
+      std::string_view line{connection.in.data() + start, end - start};
+      if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      if (!line.empty()) {
+        m_batch.push_back({it->first, std::string{line}, now});
+        ++connection.pending;
+      }
+    }
+    connection.in.erase(0, start);
+
+    if (connection.in.size() > MAX_LINE) {
+      connection.out += errorReply({}, "line too long");
+      connection.in.clear();
+      connection.readable = false;
+    }
+    update(it);
+  }
+
+  // Requests past --max-queue are turned away
+  void queueBatch() {
+    std::size_t waiting = m_jobs.size();
+    std::size_t room =
+        m_config.maxQueue > waiting ? m_config.maxQueue - waiting : 0;
+    if (m_batch.size() > room) {
+      for (std::size_t i = room; i < m_batch.size(); ++i) {
+        std::string_view line{m_batch[i].line};
+        reply(m_batch[i].connection, errorReply(isola::nextToken(line), "busy"));
+      }
+      m_batch.resize(room);
+    }
+    m_jobs.push(m_batch);
+  }
+
+  void deliverReplies() {
+    std::uint64_t count;
+    [[maybe_unused]] ssize_t size = ::read(m_wakeFd, &count, sizeof(count));
+
+    std::vector<Reply> replies;
+    m_replies.take(replies);
+    for (const Reply &answer : replies) {
+      reply(answer.connection, answer.text);
+    }
+  }
+
+  // Answers to connections that have gone away are dropped
+  void reply(std::uint64_t id, std::string_view text) {
+    auto found = m_connections.find(id);
+    if (found != m_connections.end()) {
+      --found->second.pending;
+      found->second.out += text;
+      update(found);
+    }
+  }
+
+  // Writes what it can, then closes the connection once it is done or
+  // waits for it to become readable or writable again
+  void update(ConnectionIt it) {
+    Connection &connection = it->second;
+    std::size_t sent = 0;
+    while (sent < connection.out.size()) {
+      ssize_t size = ::send(connection.fd, connection.out.data() + sent,
+                            connection.out.size() - sent, MSG_NOSIGNAL);
+      if (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        close(it);
+        return;
+      }
+      if (size <= 0) {
+        break;
+      }
+      sent += size;
+    }
+    connection.out.erase(0, sent);
+
+    if (!connection.readable && connection.pending == 0 &&
+        connection.out.empty()) {
+      close(it);
+      return;
+    }
+    std::uint32_t events = (connection.readable ? EPOLLIN : 0) |
+                           (connection.out.empty() ? 0 : EPOLLOUT);
+    if (events != connection.events) {
+      epoll_event event{};
+      event.events = events;
+      event.data.u64 = it->first;
+      ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, connection.fd, &event);
+      connection.events = events;
+    }
+  }
+
+  void close(ConnectionIt it) {
+    ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    m_connections.erase(it);
+  }
+};
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg{argv[i]};
+    const char *value = argv[i + 1];
+
+    if (arg == "--port") {
+      config.port = std::atoi(value);
+    } else if (arg == "--host") {
+      config.host = value;
+    } else if (arg == "--unix") {
+      config.unixPath = value;
+    } else if (arg == "--workers") {
+      config.workers = std::max(1, std::atoi(value));
+    } else if (arg == "--hash") {
+      config.hashMB = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--max-movetime") {
+      config.maxMoveTime =
+          std::chrono::milliseconds{std::max(1, std::atoi(value))};
+    } else if (arg == "--max-queue") {
+      config.maxQueue = std::strtoull(value, nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr,
+                 "Usage: %s [--port <n>] [--host <ipv4>] [--unix <path>]\n"
+                 "       [--workers <n>] [--hash <mb>] [--max-movetime <ms>]\n"
+                 "       [--max-queue <n>]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Blocked before any thread starts so all of them inherit it and the
+  // signals only ever arrive through the signalfd
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  int signalFd = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  int wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (signalFd < 0 || wakeFd < 0) {
+    std::perror("isola_server");
+    return EXIT_FAILURE;
+  }
+
+  JobQueue jobs;
+  ReplyQueue replies(wakeFd);
+  std::atomic<std::uint64_t> served{0};
+  int status = EXIT_SUCCESS;
+  {
+    Server server(config, jobs, replies, wakeFd, signalFd);
+    if (!server.listen()) {
+      status = EXIT_FAILURE;
+    } else {
+      std::vector<std::thread> workers;
+      for (int i = 0; i < config.workers; ++i) {
+        workers.emplace_back(work, std::cref(config), std::ref(jobs),
+                             std::ref(replies), std::ref(served));
+      }
+      server.run();
+
+      // Searches already running finish within their budget
+      jobs.close();
+      for (std::thread &worker : workers) {
+        worker.join();
+      }
+      std::fprintf(stderr, "%llu requests served\n",
+                   static_cast<unsigned long long>(served.load()));
+    }
+  }
+  ::close(wakeFd);
+  ::close(signalFd);
+  return status;
+}
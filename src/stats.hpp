@@ -0,0 +1,297 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Search statistics, compiled in by building with -DISOLA_STATS=ON.
+
+    Every search thread counts into its own StatsRecorder with plain
+    increments, no atomics and no sharing, and the engine adds the threads'
+    counts up once they have been joined. Without ISOLA_STATS the recorder
+    is an empty class whose members do nothing, so the search compiles to
+    the same code as before and the engine's stats stay empty.
+
+    Counted for each ply from the root:
+        nodes                   step and arrow nodes
+        tt probes, hits         hits are probes that found the position
+        tt cutoffs              nodes answered by the table alone
+        cutoffs                 beta cutoffs, and how many of them came
+                                from the first move tried
+    and over the whole search:
+        partition checks        and the time spent finding partitions
+        evaluations             and the time spent in them
+        iterations              when each thread started and finished
+                                each depth, and its nodes by then
+
+    writeStatsJson writes all of it as one JSON object, writeChromeTrace
+    the iterations as a trace for chrome://tracing or Perfetto, one track
+    per thread. Timing reads steady_clock around every evaluation, which
+    slows a stats build down by a fair amount: compare times between stats
+    builds only.
+
+    clang-format on
+*/
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "eval.hpp"
+
+#ifndef ISOLA_STATS
+#define ISOLA_STATS 0
+#endif
+
+namespace isola {
+
+constexpr bool STATS_ENABLED = ISOLA_STATS != 0;
+
+struct PlyStats {
+  std::uint64_t nodes = 0;
+  std::uint64_t ttProbes = 0;
+  std::uint64_t ttHits = 0;
+  std::uint64_t ttCutoffs = 0;
+  std::uint64_t cutoffs = 0;
+  std::uint64_t firstMoveCutoffs = 0;
+
+  void add(const PlyStats &other) {
+    nodes += other.nodes;
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    ttCutoffs += other.ttCutoffs;
+    cutoffs += other.cutoffs;
+    firstMoveCutoffs += other.firstMoveCutoffs;
+  }
+};
+
+// One finished or cut short iteration of one thread, times are from the
+// start of the search
+struct IterationSpan {
+  int thread;
+  int depth;
+  std::chrono::microseconds start;
+  std::chrono::microseconds end;
+  std::uint64_t nodes;
+};
+
+struct SearchStats {
+  // Steps at MAX_PLY are still counted before they are evaluated
+  std::array<PlyStats, MAX_PLY + 1> plies{};
+  std::uint64_t partitionChecks = 0;
+  std::uint64_t partitionsSolved = 0;
+  std::chrono::nanoseconds partitionTime{0};
+  std::uint64_t evals = 0;
+  std::chrono::nanoseconds evalTime{0};
+  std::vector<IterationSpan> iterations;
+  int threads = 0;
+
+  void clear() { *this = SearchStats{}; }
+
+  void add(const SearchStats &other) {
+    for (std::size_t i = 0; i < plies.size(); ++i) {
+      plies[i].add(other.plies[i]);
+    }
+    partitionChecks += other.partitionChecks;
+    partitionsSolved += other.partitionsSolved;
+    partitionTime += other.partitionTime;
+    evals += other.evals;
+    evalTime += other.evalTime;
+    iterations.insert(iterations.end(), other.iterations.begin(),
+                      other.iterations.end());
+    threads += other.threads;
+  }
+
+  PlyStats total() const {
+    PlyStats sum;
+    for (const PlyStats &ply : plies) {
+      sum.add(ply);
+    }
+    return sum;
+  }
+};
+
+// Does nothing, see below for the counting one
+template <bool Enabled> class BasicStatsRecorder {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  void start(int, Clock::time_point) {}
+  void node(int) {}
+  void ttProbe(int, bool) {}
+  void ttCutoff(int) {}
+  void cutoff(int, bool) {}
+  void startIteration(int) {}
+  void endIteration(int, std::uint64_t) {}
+  template <class F> auto timePartition(F &&find) { return find(); }
+  void partitionSolved() {}
+  template <class F> auto timeEval(F &&eval) { return eval(); }
+  void addTo(SearchStats &) const {}
+};
+
+template <> class BasicStatsRecorder<true> {
+public:
+  using Clock = std::chrono::steady_clock;
+
+private:
+  SearchStats m_stats;
+  int m_thread = 0;
+  Clock::time_point m_searchStart;
+  Clock::time_point m_iterationStart;
+
+public:
+  // Forgets the last search
+  void start(int thread, Clock::time_point searchStart) {
+    m_stats.clear();
+    m_stats.threads = 1;
+    m_thread = thread;
+    m_searchStart = searchStart;
+  }
+
+  void node(int ply) { ++m_stats.plies[ply].nodes; }
+
+  void ttProbe(int ply, bool hit) {
+    ++m_stats.plies[ply].ttProbes;
+    m_stats.plies[ply].ttHits += hit;
+  }
+
+  void ttCutoff(int ply) { ++m_stats.plies[ply].ttCutoffs; }
+
+  void cutoff(int ply, bool firstMove) {
+    ++m_stats.plies[ply].cutoffs;
+    m_stats.plies[ply].firstMoveCutoffs += firstMove;
+  }
+
+  void startIteration(int) { m_iterationStart = Clock::now(); }
+
+  void endIteration(int depth, std::uint64_t nodes) {
+    auto sinceStart = [&](Clock::time_point time) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+          time - m_searchStart);
+    };
+    m_stats.iterations.push_back({.thread = m_thread,
+                                  .depth = depth,
+                                  .start = sinceStart(m_iterationStart),
+                                  .end = sinceStart(Clock::now()),
+                                  .nodes = nodes});
+  }
+
+  template <class F> auto timePartition(F &&find) {
+    Clock::time_point start = Clock::now();
+    auto partition = find();
+    m_stats.partitionTime += Clock::now() - start;
+    ++m_stats.partitionChecks;
+    return partition;
+  }
+
+  void partitionSolved() { ++m_stats.partitionsSolved; }
+
+  template <class F> auto timeEval(F &&eval) {
+    Clock::time_point start = Clock::now();
+    auto score = eval();
+    m_stats.evalTime += Clock::now() - start;
+    ++m_stats.evals;
+    return score;
+  }
+
+  void addTo(SearchStats &stats) const { stats.add(m_stats); }
+};
+
+using StatsRecorder = BasicStatsRecorder<STATS_ENABLED>;
+
+namespace detail {
+
+inline double ratio(std::uint64_t part, std::uint64_t whole) {
+  return whole > 0 ? static_cast<double>(part) / whole : 0.0;
+}
+
+} // namespace detail
+
+inline bool writeStatsJson(const SearchStats &stats, std::FILE *file) {
+  PlyStats total = stats.total();
+  std::fprintf(file, "{\n  \"threads\": %d,\n", stats.threads);
+  std::fprintf(file,
+               "  \"nodes\": %llu,\n  \"tt_probes\": %llu,\n"
+               "  \"tt_hits\": %llu,\n  \"tt_cutoffs\": %llu,\n"
+               "  \"cutoffs\": %llu,\n  \"first_move_cutoff_rate\": %.4f,\n",
+               static_cast<unsigned long long>(total.nodes),
+               static_cast<unsigned long long>(total.ttProbes),
+               static_cast<unsigned long long>(total.ttHits),
+               static_cast<unsigned long long>(total.ttCutoffs),
+               static_cast<unsigned long long>(total.cutoffs),
+               detail::ratio(total.firstMoveCutoffs, total.cutoffs));
+  std::fprintf(
+      file,
+      "  \"partition\": {\"checks\": %llu, \"solved\": %llu, "
+      "\"ns\": %lld, \"ns_per_check\": %.1f},\n",
+      static_cast<unsigned long long>(stats.partitionChecks),
+      static_cast<unsigned long long>(stats.partitionsSolved),
+      static_cast<long long>(stats.partitionTime.count()),
+      detail::ratio(stats.partitionTime.count(), stats.partitionChecks));
+  std::fprintf(file,
+               "  \"eval\": {\"count\": %llu, \"ns\": %lld, "
+               "\"ns_per_eval\": %.1f},\n",
+               static_cast<unsigned long long>(stats.evals),
+               static_cast<long long>(stats.evalTime.count()),
+               detail::ratio(stats.evalTime.count(), stats.evals));
+
+  // Plies past the deepest one reached are left out
+  std::size_t plies = stats.plies.size();
+  while (plies > 0 && stats.plies[plies - 1].nodes == 0) {
+    --plies;
+  }
+  std::fprintf(file, "  \"plies\": [");
+  for (std::size_t i = 0; i < plies; ++i) {
+    const PlyStats &ply = stats.plies[i];
+    std::fprintf(
+        file,
+        "%s\n    {\"ply\": %zu, \"nodes\": %llu, \"tt_probes\": %llu, "
+        "\"tt_hits\": %llu, \"tt_cutoffs\": %llu, \"cutoffs\": %llu, "
+        "\"first_move_cutoffs\": %llu, \"first_move_cutoff_rate\": %.4f}",
+        i > 0 ? "," : "", i, static_cast<unsigned long long>(ply.nodes),
+        static_cast<unsigned long long>(ply.ttProbes),
+        static_cast<unsigned long long>(ply.ttHits),
+        static_cast<unsigned long long>(ply.ttCutoffs),
+        static_cast<unsigned long long>(ply.cutoffs),
+        static_cast<unsigned long long>(ply.firstMoveCutoffs),
+        detail::ratio(ply.firstMoveCutoffs, ply.cutoffs));
+  }
+  std::fprintf(file, "\n  ],\n  \"iterations\": [");
+  for (std::size_t i = 0; i < stats.iterations.size(); ++i) {
+    const IterationSpan &span = stats.iterations[i];
+    std::fprintf(file,
+                 "%s\n    {\"thread\": %d, \"depth\": %d, \"start_us\": %lld, "
+                 "\"end_us\": %lld, \"nodes\": %llu}",
+                 i > 0 ? "," : "", span.thread, span.depth,
+                 static_cast<long long>(span.start.count()),
+                 static_cast<long long>(span.end.count()),
+                 static_cast<unsigned long long>(span.nodes));
+  }
+  return std::fprintf(file, "\n  ]\n}\n") > 0 && !std::ferror(file);
+}
+
+// Trace Event Format: a complete event per thread and iteration
+inline bool writeChromeTrace(const SearchStats &stats, std::FILE *file) {
+  std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  for (int thread = 0; thread < stats.threads; ++thread) {
+    std::fprintf(file,
+                 "%s\n  {\"name\": \"thread_name\", \"ph\": \"M\", "
+                 "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                 thread > 0 ? "," : "", thread,
+                 thread == 0 ? "main" : "helper", thread);
+  }
+  for (const IterationSpan &span : stats.iterations) {
+    std::fprintf(file,
+                 ",\n  {\"name\": \"depth %d\", \"cat\": \"search\", "
+                 "\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %lld, "
+                 "\"dur\": %lld, \"args\": {\"nodes\": %llu}}",
+                 span.depth, span.thread,
+                 static_cast<long long>(span.start.count()),
+                 static_cast<long long>((span.end - span.start).count()),
+                 static_cast<unsigned long long>(span.nodes));
+  }
+  return std::fprintf(file, "\n]}\n") > 0 && !std::ferror(file);
+}
+
+} // namespace isola
@@ -0,0 +1,183 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Symmetries of the board and hashing positions up to symmetry.
+
+    A board has four symmetries, flipping the rows and/or the columns, and a
+    square board four more that also swap rows and columns. Symmetry t is the
+    number with bit 0 set to flip the rows, bit 1 to flip the columns and
+    bit 2 to swap them, zero is the identity. Mirrored positions have the
+    same value and mirrored best moves, so a table keyed by the smallest hash
+    of a position's images stores each pair of mirrored positions once:
+
+        key         min over the symmetries t in use of hash(t(position))
+        symmetry    the t that gave the key, moves are stored as t(move)
+
+    An entry is then exactly the entry of the image t(position) under its
+    plain hash, so tables filled with and without canonical keys can be
+    mixed freely, they only miss the lookups they don't share.
+
+    Mirrored positions only both turn up below a position that is symmetric
+    itself, such as the start position, which is left/right symmetric on
+    boards with an odd number of columns. So callers canonicalize with the
+    symmetries of the root they started from, and once those are broken by
+    the moves played that is no symmetry at all: the key is the plain hash
+    and nothing is computed.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#include "bitboard.hpp"
+#include "game_state.hpp"
+#include "zobrist.hpp"
+
+namespace isola {
+
+template <class G> constexpr int SYMMETRIES = G::ROWS == G::COLS ? 8 : 4;
+
+namespace detail {
+
+template <class G>
+constexpr Square applySymmetry(int symmetry, int row, int col) {
+  if (symmetry & 1) {
+    row = G::ROWS - 1 - row;
+  }
+  if (symmetry & 2) {
+    col = G::COLS - 1 - col;
+  }
+  if (symmetry & 4) {
+    std::swap(row, col);
+  }
+  return G::toSquare(row, col);
+}
+
+// Indexed by [symmetry][square]
+template <class G>
+constexpr auto SYMMETRY_SQUARES = [] {
+  std::array<std::array<Square, G::SQUARES>, SYMMETRIES<G>> table{};
+  for (int t = 0; t < SYMMETRIES<G>; ++t) {
+    for (Square sq = 0; sq < G::SQUARES; ++sq) {
+      table[t][sq] = applySymmetry<G>(t, G::rowOf(sq), G::colOf(sq));
+    }
+  }
+  return table;
+}();
+
+template <class G>
+constexpr auto INVERSE_SYMMETRY = [] {
+  std::array<int, SYMMETRIES<G>> inverse{};
+  for (int t = 0; t < SYMMETRIES<G>; ++t) {
+    for (int u = 0; u < SYMMETRIES<G>; ++u) {
+      bool undoes = true;
+      for (Square sq = 0; sq < G::SQUARES; ++sq) {
+        undoes &= SYMMETRY_SQUARES<G>[u][SYMMETRY_SQUARES<G>[t][sq]] == sq;
+      }
+      if (undoes) {
+        inverse[t] = u;
+      }
+    }
+  }
+  return inverse;
+}();
+
+// The dead square keys of each image, [t][sq] is the key of t(sq)
+template <class G>
+constexpr auto SYMMETRIC_DEAD_KEYS = [] {
+  std::array<std::array<std::uint64_t, G::SQUARES>, SYMMETRIES<G>> keys{};
+  for (int t = 0; t < SYMMETRIES<G>; ++t) {
+    for (Square sq = 0; sq < G::SQUARES; ++sq) {
+      keys[t][sq] = ZOBRIST<G>.dead[SYMMETRY_SQUARES<G>[t][sq]];
+    }
+  }
+  return keys;
+}();
+
+} // namespace detail
+
+template <class G> constexpr Square transformSquare(int symmetry, Square sq) {
+  return sq == NO_SQUARE ? NO_SQUARE
+                         : detail::SYMMETRY_SQUARES<G>[symmetry][sq];
+}
+
+template <class G> constexpr Move transformMove(int symmetry, Move move) {
+  auto image = [&](std::int8_t sq) {
+    return static_cast<std::int8_t>(transformSquare<G>(symmetry, sq));
+  };
+  return {.from = image(move.from),
+          .to = image(move.to),
+          .arrow = image(move.arrow)};
+}
+
+// Brings a move stored for the image under `symmetry` back to the position
+template <class G> constexpr Move untransformMove(int symmetry, Move move) {
+  return transformMove<G>(detail::INVERSE_SYMMETRY<G>[symmetry], move);
+}
+
+// hash(t(state)) without building the image
+template <class G>
+std::uint64_t transformedHash(const BasicGameState<G> &state, int symmetry) {
+  const auto &dead = detail::SYMMETRIC_DEAD_KEYS<G>[symmetry];
+  std::uint64_t hash = state.sideToMove() ? ZOBRIST<G>.side : 0;
+  for (typename G::Bitboard bb = state.dead(); bb;) {
+    hash ^= dead[popLowest(bb)];
+  }
+  for (int i = 0; i < 2; ++i) {
+    hash ^= ZOBRIST<G>.player[i][transformSquare<G>(symmetry, state.player(i))];
+  }
+  return hash;
+}
+
+// Bit t is set when symmetry t maps the position onto itself, the identity
+// is left out
+template <class G>
+unsigned positionSymmetries(const BasicGameState<G> &state) {
+  unsigned symmetries = 0;
+  for (int t = 1; t < SYMMETRIES<G>; ++t) {
+    if (transformSquare<G>(t, state.player(0)) != state.player(0) ||
+        transformSquare<G>(t, state.player(1)) != state.player(1)) {
+      continue;
+    }
+    bool symmetric = true;
+    for (typename G::Bitboard bb = state.dead(); bb && symmetric;) {
+      Square sq = popLowest(bb);
+      Square image = transformSquare<G>(t, sq);
+      symmetric = (state.dead() & G::squareBit(image)) != 0;
+    }
+    if (symmetric) {
+      symmetries |= 1u << t;
+    }
+  }
+  return symmetries;
+}
+
+struct CanonicalKey {
+  std::uint64_t key;
+  int symmetry;
+};
+
+// The smallest hash of the position's images under `symmetries`, a mask
+// from positionSymmetries(). No symmetries is just the plain hash
+template <class G>
+CanonicalKey canonicalKey(const BasicGameState<G> &state,
+                          unsigned symmetries) {
+  CanonicalKey canonical{state.hash(), 0};
+  while (symmetries) {
+    int t = std::countr_zero(symmetries);
+    symmetries &= symmetries - 1;
+    std::uint64_t key = transformedHash(state, t);
+    if (key < canonical.key) {
+      canonical = {key, t};
+    }
+  }
+  return canonical;
+}
+
+} // namespace isola
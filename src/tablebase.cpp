@@ -0,0 +1,115 @@
+/*
+    clang-format off
+
+    isola_tablebase: solves every region that fits in the tablebase window
+    and writes the endgame tablebase the engine probes, see tablebase.hpp.
+
+        isola_tablebase [--out <file>]
+
+    The file (default endgame.tb) doesn't depend on the board size, one
+    tablebase serves every board. isola --tablebase <file> plays with it.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "endgame.hpp"
+#include "tablebase.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using G = isola::TablebaseGeometry;
+
+struct Config {
+  const char *out = "endgame.tb";
+};
+
+constexpr G::Bitboard REGION_MASK =
+    (G::Bitboard{1} << isola::TABLEBASE_CELLS) - 1;
+
+isola::Square keySquare(std::uint32_t key) {
+  return static_cast<isola::Square>(key >> isola::TABLEBASE_CELLS);
+}
+
+// The key's shape when it is one the table could hold: a region connected
+// to the player, both already in the top left corner of the window
+bool keyShape(std::uint32_t key, isola::detail::WindowShape &shape) {
+  isola::Square from = keySquare(key);
+  G::Bitboard region = key & REGION_MASK;
+  if (region & G::squareBit(from) ||
+      isola::floodFill<G>(from, region) != region ||
+      !isola::detail::toWindowShape<G>(from, region, shape)) {
+    return false;
+  }
+  // The player only keeps its square when the bounding box doesn't move
+  return shape.start == from;
+}
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg{argv[i]};
+    const char *value = argv[i + 1];
+
+    if (arg == "--out") {
+      config.out = value;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+int run(const Config &config) {
+  Clock::time_point start = Clock::now();
+
+  std::vector<std::uint64_t> canonical(isola::TABLEBASE_WORDS);
+  std::vector<std::uint8_t> values;
+  isola::WalkSolver<G> solver;
+  int longest = 0;
+  for (std::uint32_t key = 0; key < isola::TABLEBASE_KEYS; ++key) {
+    isola::detail::WindowShape shape;
+    if (!keyShape(key, shape) || isola::detail::canonicalKey(shape) != key) {
+      continue;
+    }
+
+    isola::Square from = keySquare(key);
+    G::Bitboard region = key & REGION_MASK;
+    int walk = solver.walk(from, region);
+    int afterArrow = solver.walkAfterArrow(from, region);
+    longest = std::max(longest, walk);
+
+    canonical[key / 64] |= std::uint64_t{1} << (key % 64);
+    values.push_back(static_cast<std::uint8_t>(walk | afterArrow << 4));
+  }
+
+  if (!isola::writeTablebase(config.out, canonical, values)) {
+    std::perror(config.out);
+    return EXIT_FAILURE;
+  }
+  std::fprintf(stderr,
+               "%zu regions written to %s in %.1f s, longest walk %d\n",
+               values.size(), config.out,
+               std::chrono::duration<double>(Clock::now() - start).count(),
+               longest);
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr, "Usage: %s [--out <file>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  return run(config);
+}
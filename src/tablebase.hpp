@@ -0,0 +1,294 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Endgame tablebase for the walled off regions WalkSolver plays out.
+
+    How many steps a player gets in its own region only depends on the shape
+    of the region and on where the player stands in it, not on the rest of
+    the board or even on the board size. isola_tablebase solves every region
+    that fits in a 4 by 4 window together with its player, at most 15 free
+    squares, once and for all:
+
+        header    magic "ISTB", version, window size, canonical entry count
+        ranks     for every 64-bit word of the bitmap, the number of
+                  canonical keys in the words before it
+        bitmap    one bit per key, set for the canonical keys
+        values    one byte per canonical key in key order, the steps when the
+                  walker moves first in the low nibble, when the arrow lands
+                  first in the high nibble
+
+    A key is the player's square in bits 16-19 and the region's mask in bits
+    0-15, both in window coordinates with the bounding box of the player and
+    the region moved to the top left corner. Of the (up to) eight keys the
+    rotations and reflections of a region give, only the smallest one is in
+    the table, and only regions connected to the player exist at all. That
+    leaves about one key in thirty, and the rank counts turn a key into its
+    value's index without any search: a probe is a bounding box, eight masks
+    and two memory reads, whatever the size of the region.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "mapped_file.hpp"
+
+namespace isola {
+
+constexpr std::uint8_t TABLEBASE_VERSION = 1;
+
+// Rows and columns of the window the regions have to fit in
+constexpr int TABLEBASE_WINDOW = 4;
+constexpr int TABLEBASE_CELLS = TABLEBASE_WINDOW * TABLEBASE_WINDOW;
+constexpr std::uint32_t TABLEBASE_KEYS = std::uint32_t{TABLEBASE_CELLS}
+                                         << TABLEBASE_CELLS;
+constexpr std::size_t TABLEBASE_WORDS = TABLEBASE_KEYS / 64;
+
+// The window as a board of its own, the generator solves regions on it
+using TablebaseGeometry = Geometry<TABLEBASE_WINDOW, TABLEBASE_WINDOW>;
+
+struct TablebaseHeader {
+  char magic[4] = {'I', 'S', 'T', 'B'};
+  std::uint8_t version = TABLEBASE_VERSION;
+  std::uint8_t window = TABLEBASE_WINDOW;
+  std::uint8_t reserved[2] = {};
+  std::uint32_t count = 0;
+  std::uint32_t reserved2 = 0;
+};
+
+static_assert(sizeof(TablebaseHeader) == 16, "ranks follow the header");
+
+namespace detail {
+
+// A player and its region relative to their bounding box
+struct WindowShape {
+  int rows = 0;
+  int cols = 0;
+  std::uint8_t start = 0;
+  int count = 0;
+  std::uint8_t cells[TABLEBASE_CELLS] = {};
+};
+
+// Where cell r * WINDOW + c of a rows x cols box goes under each of the eight
+// symmetries, already moved back to the top left corner: bit 0 flips the
+// rows, bit 1 the columns and bit 2 swaps rows and columns
+constexpr auto WINDOW_SYMMETRIES = [] {
+  constexpr int W = TABLEBASE_WINDOW;
+  std::array<std::array<std::array<std::array<std::uint8_t, 8>,
+                                   TABLEBASE_CELLS>,
+                        W>,
+             W>
+      table{};
+  for (int rows = 1; rows <= W; ++rows) {
+    for (int cols = 1; cols <= W; ++cols) {
+      for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+          for (int t = 0; t < 8; ++t) {
+            int row = t & 1 ? rows - 1 - r : r;
+            int col = t & 2 ? cols - 1 - c : c;
+            if (t & 4) {
+              std::swap(row, col);
+            }
+            table[rows - 1][cols - 1][r * W + c][t] =
+                static_cast<std::uint8_t>(row * W + col);
+          }
+        }
+      }
+    }
+  }
+  return table;
+}();
+
+constexpr std::uint32_t windowKey(const WindowShape &shape, int symmetry) {
+  const auto &moved = WINDOW_SYMMETRIES[shape.rows - 1][shape.cols - 1];
+  std::uint32_t mask = 0;
+  for (int i = 0; i < shape.count; ++i) {
+    mask |= std::uint32_t{1} << moved[shape.cells[i]][symmetry];
+  }
+  return std::uint32_t{moved[shape.start][symmetry]} << TABLEBASE_CELLS |
+         mask;
+}
+
+constexpr std::uint32_t canonicalKey(const WindowShape &shape) {
+  std::uint32_t best = windowKey(shape, 0);
+  for (int t = 1; t < 8; ++t) {
+    best = std::min(best, windowKey(shape, t));
+  }
+  return best;
+}
+
+// The shape of `region` with the player on `from`, false when they don't fit
+// in the window
+template <class G>
+constexpr bool toWindowShape(Square from, typename G::Bitboard region,
+                             WindowShape &shape) {
+  Square squares[TABLEBASE_CELLS];
+  int count = 0;
+  int top = G::rowOf(from), bottom = top;
+  int left = G::colOf(from), right = left;
+  for (typename G::Bitboard bb = region; bb;) {
+    // The player takes up one cell of the window
+    if (count == TABLEBASE_CELLS - 1) {
+      return false;
+    }
+    Square sq = popLowest(bb);
+    squares[count++] = sq;
+    top = std::min(top, G::rowOf(sq));
+    bottom = std::max(bottom, G::rowOf(sq));
+    left = std::min(left, G::colOf(sq));
+    right = std::max(right, G::colOf(sq));
+    if (bottom - top >= TABLEBASE_WINDOW ||
+        right - left >= TABLEBASE_WINDOW) {
+      return false;
+    }
+  }
+
+  auto cell = [&](Square sq) {
+    return static_cast<std::uint8_t>((G::rowOf(sq) - top) * TABLEBASE_WINDOW +
+                                     G::colOf(sq) - left);
+  };
+  shape.rows = bottom - top + 1;
+  shape.cols = right - left + 1;
+  shape.start = cell(from);
+  shape.count = count;
+  for (int i = 0; i < count; ++i) {
+    shape.cells[i] = cell(squares[i]);
+  }
+  return true;
+}
+
+} // namespace detail
+
+// Lays a tablebase out as a file. `canonical` has a bit set for every key in
+// the table and `values` holds their values in key order
+inline bool writeTablebase(const char *path,
+                           const std::vector<std::uint64_t> &canonical,
+                           const std::vector<std::uint8_t> &values) {
+  if (canonical.size() != TABLEBASE_WORDS) {
+    return false;
+  }
+
+  TablebaseHeader header;
+  std::vector<std::uint32_t> ranks(TABLEBASE_WORDS);
+  for (std::size_t i = 0; i < TABLEBASE_WORDS; ++i) {
+    ranks[i] = header.count;
+    header.count += std::popcount(canonical[i]);
+  }
+  if (header.count != values.size()) {
+    return false;
+  }
+
+  std::FILE *file = std::fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok =
+      std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+      std::fwrite(ranks.data(), sizeof(std::uint32_t), TABLEBASE_WORDS,
+                  file) == TABLEBASE_WORDS &&
+      std::fwrite(canonical.data(), sizeof(std::uint64_t), TABLEBASE_WORDS,
+                  file) == TABLEBASE_WORDS &&
+      std::fwrite(values.data(), 1, values.size(), file) == values.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+// A read-only mapping of a tablebase file, the same file serves every board
+// size
+class Tablebase {
+  static constexpr std::size_t RANKS_OFFSET = sizeof(TablebaseHeader);
+  static constexpr std::size_t BITMAP_OFFSET =
+      RANKS_OFFSET + TABLEBASE_WORDS * sizeof(std::uint32_t);
+  static constexpr std::size_t VALUES_OFFSET =
+      BITMAP_OFFSET + TABLEBASE_WORDS * sizeof(std::uint64_t);
+
+  MappedFile m_file;
+
+  explicit Tablebase(MappedFile file) : m_file(std::move(file)) {}
+
+  const std::uint32_t *ranks() const {
+    return reinterpret_cast<const std::uint32_t *>(m_file.data() +
+                                                   RANKS_OFFSET);
+  }
+  const std::uint64_t *bitmap() const {
+    return reinterpret_cast<const std::uint64_t *>(m_file.data() +
+                                                   BITMAP_OFFSET);
+  }
+  const std::uint8_t *values() const {
+    return reinterpret_cast<const std::uint8_t *>(m_file.data() +
+                                                  VALUES_OFFSET);
+  }
+
+public:
+  // Nothing when the file can't be mapped, is truncated or isn't a tablebase
+  // of this version
+  static std::optional<Tablebase> open(const char *path) {
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file || file->size() < VALUES_OFFSET) {
+      return std::nullopt;
+    }
+
+    Tablebase tablebase(std::move(*file));
+    const TablebaseHeader &header = tablebase.header();
+    TablebaseHeader expected;
+    if (std::memcmp(header.magic, expected.magic, 4) != 0 ||
+        header.version != expected.version ||
+        header.window != expected.window ||
+        tablebase.m_file.size() - VALUES_OFFSET < header.count) {
+      return std::nullopt;
+    }
+    tablebase.m_file.advise(MADV_RANDOM);
+    return tablebase;
+  }
+
+  const TablebaseHeader &header() const {
+    return *reinterpret_cast<const TablebaseHeader *>(m_file.data());
+  }
+
+  // Regions in the table, counting each set of symmetric ones once
+  std::size_t size() const { return header().count; }
+
+  // Whether probe() knows the region, without looking anything up
+  template <class G>
+  bool covers(Square from, typename G::Bitboard region) const {
+    detail::WindowShape shape;
+    return detail::toWindowShape<G>(from, region, shape);
+  }
+
+  // Sets steps to what WalkSolver would return for `region`, which must be
+  // everything reachable from `from`, and returns true when the region fits
+  // in the window
+  template <class G>
+  bool probe(Square from, typename G::Bitboard region, bool deleterToMove,
+             int &steps) const {
+    detail::WindowShape shape;
+    if (!detail::toWindowShape<G>(from, region, shape)) {
+      return false;
+    }
+
+    std::uint32_t key = detail::canonicalKey(shape);
+    std::uint64_t word = bitmap()[key / 64];
+    std::uint64_t below = (std::uint64_t{1} << (key % 64)) - 1;
+    if (!(word >> (key % 64) & 1)) {
+      // Only when the region isn't connected to `from`
+      return false;
+    }
+    std::uint8_t value =
+        values()[ranks()[key / 64] + std::popcount(word & below)];
+    steps = deleterToMove ? value >> 4 : value & 0xf;
+    return true;
+  }
+};
+
+} // namespace isola
@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Time management for games played on a clock.
+
+    allocateTime turns the time left on the side to move's clock into the
+    limits of one search:
+        - the soft time is an even share of the clock over the moves the
+          side is still expected to make, plus most of the increment. The
+          search doesn't start another iteration past it, or sooner once the
+          best move has stopped changing
+        - the hard time (SearchLimits::moveTime) is a few soft times, but
+          never more than a fixed share of the clock, and the search is
+          stopped when it runs out whatever it is doing
+    How many moves are left is guessed from the free squares. A game between
+    engines takes about one turn of each side per 8 free squares at the
+    start on every board size, since most of the board is still free when a
+    player is walled in, and two more moves are kept in reserve.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <chrono>
+
+#include "bitboard.hpp"
+#include "game_state.hpp"
+#include "search.hpp"
+
+namespace isola {
+
+struct GameClock {
+  std::chrono::milliseconds remaining{0};
+  std::chrono::milliseconds increment{0};
+  // Moves until the clock is topped up again, zero when it has to last the
+  // whole game
+  int movesToGo = 0;
+  // Lost on every move outside the search, by the UI or the network
+  std::chrono::milliseconds overhead{10};
+};
+
+constexpr int FREE_SQUARES_PER_MOVE = 8;
+constexpr int RESERVE_MOVES = 2;
+// Hard time as a multiple of the soft time and as a share of the clock
+constexpr int HARD_TIME_FACTOR = 3;
+constexpr int HARD_TIME_PERCENT = 60;
+
+// Moves the side to move is still expected to make
+template <class G> int expectedMovesLeft(const BasicGameState<G> &state) {
+  return popCount(state.free()) / FREE_SQUARES_PER_MOVE + RESERVE_MOVES;
+}
+
+// `limits` with the times set from the clock, for the side to move of
+// `state`. Depth and node limits are kept as they are
+template <class G>
+SearchLimits allocateTime(const BasicGameState<G> &state,
+                          const GameClock &clock, SearchLimits limits = {}) {
+  using std::chrono::milliseconds;
+
+  milliseconds usable =
+      std::max(clock.remaining - clock.overhead, milliseconds{1});
+  int movesLeft = expectedMovesLeft(state);
+  if (clock.movesToGo > 0) {
+    movesLeft = std::min(movesLeft, clock.movesToGo);
+  }
+
+  milliseconds soft = usable / movesLeft + clock.increment * 3 / 4;
+  milliseconds hard = std::min(soft * HARD_TIME_FACTOR,
+                               usable * HARD_TIME_PERCENT / 100);
+  limits.moveTime = std::max(hard, milliseconds{1});
+  limits.softTime = std::clamp(soft, milliseconds{1}, limits.moveTime);
+  return limits;
+}
+
+} // namespace isola
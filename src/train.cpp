@@ -0,0 +1,386 @@
+/*
+    clang-format off
+
+    isola_train: fits an evaluation network (see nnue.hpp) to the results
+    of self-play games.
+
+        isola_train --records <file> [--out <file>] [--epochs <n>]
+                    [--batch <n>] [--lr <rate>] [--skip-plies <n>]
+                    [--games <n>] [--seed <n>]
+
+    Every position of the games in the record file (see isola_selfplay) is
+    a sample, labelled with whether its side to move went on to win. The
+    network's output is taken as the logit of that, and the cross entropy
+    is minimised with Adam over mini-batches of --batch positions (default
+    1024) at a learning rate of --lr (default 0.001), --epochs times over
+    the data (default 10) in a new random order each time. Training is in
+    float, with the same clipped layers as the fixed point network the
+    engine runs, and the weights are kept within NETWORK_WEIGHT_LIMIT so
+    that they can be quantized as they are.
+
+    Every 16th game is held out and its positions only scored, the loss on
+    them is reported after each epoch next to the training loss. The first
+    --skip-plies turns of each game (default 2) are left out, they are the
+    random openings isola_selfplay plays. --games only reads that many
+    games from the start of the file.
+
+    The network is written to --out (default isola.nnue) for the board the
+    records were played on. isola --network <file> evaluates with it.
+
+    clang-format on
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "game_state.hpp"
+#include "nnue.hpp"
+#include "record.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+  const char *records = nullptr;
+  const char *out = "isola.nnue";
+  int epochs = 10;
+  std::size_t batch = 1024;
+  float learningRate = 0.001f;
+  int skipPlies = 2;
+  std::size_t games = 0; // zero reads every game
+  std::uint64_t seed = 1;
+};
+
+// Games with an index divisible by this are held out
+constexpr std::size_t VALIDATION_STRIDE = 16;
+constexpr float ADAM_BETA1 = 0.9f;
+constexpr float ADAM_BETA2 = 0.999f;
+constexpr float ADAM_EPSILON = 1e-8f;
+
+template <class G> struct Sample {
+  isola::BasicGameState<G> state;
+  // Whether the side to move won
+  float won;
+};
+
+// The inputs set in a position for each perspective, dead squares and the
+// two players
+using FeatureList = int[2][isola::MAX_BOARD_SQUARES + 2];
+
+// A float parameter with its gradient and Adam's moments
+struct Parameter {
+  float value = 0;
+  float gradient = 0;
+  float mean = 0;
+  float variance = 0;
+};
+
+template <class G> class Trainer {
+  static constexpr int H = isola::NETWORK_HIDDEN;
+  static constexpr int FEATURES = isola::NETWORK_FEATURES<G>;
+
+  const Config &m_config;
+  // The same layout as NetworkWeights
+  std::vector<Parameter> m_features;
+  std::vector<Parameter> m_biases;
+  std::vector<Parameter> m_output;
+  Parameter m_outputBias;
+  int m_steps = 0;
+
+  struct Forward {
+    float acc[2][H];
+    float output;
+  };
+
+public:
+  explicit Trainer(const Config &config)
+      : m_config(config), m_features(FEATURES * H), m_biases(H),
+        m_output(2 * H) {
+    std::mt19937_64 random(config.seed);
+    std::normal_distribution<float> small(0.0f, 0.1f);
+    for (Parameter &w : m_features) {
+      w.value = small(random);
+    }
+    for (Parameter &w : m_output) {
+      w.value = small(random);
+    }
+  }
+
+  // The cross entropy of one sample, adding its gradients when `learn`
+  float sample(const Sample<G> &sample, bool learn) {
+    FeatureList features;
+    int count = activeFeatures(sample.state, features);
+    Forward f;
+    forward(sample.state.sideToMove(), features, count, f);
+
+    float p = 1.0f / (1.0f + std::exp(-f.output));
+    p = std::clamp(p, 1e-6f, 1.0f - 1e-6f);
+    float loss = -(sample.won * std::log(p) +
+                   (1.0f - sample.won) * std::log(1.0f - p));
+    if (learn) {
+      backward(sample.state.sideToMove(), features, count, f, p - sample.won);
+    }
+    return loss;
+  }
+
+  // Applies the gradients summed over `batch` samples
+  void step(std::size_t batch) {
+    ++m_steps;
+    float scale = 1.0f / static_cast<float>(batch);
+    float correction1 = 1.0f - std::pow(ADAM_BETA1, m_steps);
+    float correction2 = 1.0f - std::pow(ADAM_BETA2, m_steps);
+    auto update = [&](Parameter &w) {
+      float g = w.gradient * scale;
+      w.gradient = 0;
+      w.mean = ADAM_BETA1 * w.mean + (1 - ADAM_BETA1) * g;
+      w.variance = ADAM_BETA2 * w.variance + (1 - ADAM_BETA2) * g * g;
+      w.value -= m_config.learningRate * (w.mean / correction1) /
+                 (std::sqrt(w.variance / correction2) + ADAM_EPSILON);
+      w.value = std::clamp(w.value, -isola::NETWORK_WEIGHT_LIMIT,
+                           isola::NETWORK_WEIGHT_LIMIT);
+    };
+    for (Parameter &w : m_features) {
+      update(w);
+    }
+    for (Parameter &w : m_biases) {
+      update(w);
+    }
+    for (Parameter &w : m_output) {
+      update(w);
+    }
+    update(m_outputBias);
+  }
+
+  void quantize(isola::NetworkWeights<G> &weights) const {
+    auto fixed = [](float value, float scale) {
+      return static_cast<std::int16_t>(std::lround(value * scale));
+    };
+    for (int f = 0; f < FEATURES; ++f) {
+      for (int i = 0; i < H; ++i) {
+        weights.features[f][i] =
+            fixed(m_features[f * H + i].value, isola::NETWORK_QA);
+      }
+    }
+    for (int i = 0; i < H; ++i) {
+      weights.biases[i] = fixed(m_biases[i].value, isola::NETWORK_QA);
+    }
+    for (int i = 0; i < 2 * H; ++i) {
+      weights.output[i] = fixed(m_output[i].value, isola::NETWORK_QB);
+    }
+    weights.outputBias = static_cast<std::int32_t>(std::lround(
+        m_outputBias.value * isola::NETWORK_QA * isola::NETWORK_QB));
+  }
+
+private:
+  // The same number for both perspectives
+  static int activeFeatures(const isola::BasicGameState<G> &state,
+                            FeatureList &features) {
+    int count = 0;
+    for (typename G::Bitboard dead = state.dead(); dead; ++count) {
+      features[0][count] = features[1][count] = isola::popLowest(dead);
+    }
+    for (int perspective = 0; perspective < 2; ++perspective) {
+      for (int side = 0; side < 2; ++side) {
+        features[perspective][count + side] =
+            isola::networkPlayerFeature<G>(perspective, side,
+                                           state.player(side));
+      }
+    }
+    return count + 2;
+  }
+
+  static float clipped(float x) { return std::clamp(x, 0.0f, 1.0f); }
+
+  void forward(int side, const FeatureList &features, int count,
+               Forward &f) const {
+    for (int perspective = 0; perspective < 2; ++perspective) {
+      float *acc = f.acc[perspective];
+      for (int i = 0; i < H; ++i) {
+        acc[i] = m_biases[i].value;
+      }
+      for (int j = 0; j < count; ++j) {
+        const Parameter *row = &m_features[features[perspective][j] * H];
+        for (int i = 0; i < H; ++i) {
+          acc[i] += row[i].value;
+        }
+      }
+    }
+
+    f.output = m_outputBias.value;
+    for (int i = 0; i < H; ++i) {
+      f.output += clipped(f.acc[side][i]) * m_output[i].value +
+                  clipped(f.acc[side ^ 1][i]) * m_output[H + i].value;
+    }
+  }
+
+  void backward(int side, const FeatureList &features, int count,
+                const Forward &f, float delta) {
+    m_outputBias.gradient += delta;
+    for (int half = 0; half < 2; ++half) {
+      int perspective = half == 0 ? side : side ^ 1;
+      const float *acc = f.acc[perspective];
+      float accGradient[H];
+      for (int i = 0; i < H; ++i) {
+        Parameter &w = m_output[half * H + i];
+        w.gradient += delta * clipped(acc[i]);
+        // The clip passes no gradient outside of (0, 1)
+        accGradient[i] = acc[i] > 0.0f && acc[i] < 1.0f ? delta * w.value : 0;
+        m_biases[i].gradient += accGradient[i];
+      }
+      for (int j = 0; j < count; ++j) {
+        Parameter *row = &m_features[features[perspective][j] * H];
+        for (int i = 0; i < H; ++i) {
+          row[i].gradient += accGradient[i];
+        }
+      }
+    }
+  }
+};
+
+bool parseArgs(int argc, char *argv[], Config &config) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg{argv[i]};
+    const char *value = argv[i + 1];
+
+    if (arg == "--records") {
+      config.records = value;
+    } else if (arg == "--out") {
+      config.out = value;
+    } else if (arg == "--epochs") {
+      config.epochs = std::max(1, std::atoi(value));
+    } else if (arg == "--batch") {
+      config.batch = std::max(1ull, std::strtoull(value, nullptr, 10));
+    } else if (arg == "--lr") {
+      config.learningRate = std::strtof(value, nullptr);
+    } else if (arg == "--skip-plies") {
+      config.skipPlies = std::max(0, std::atoi(value));
+    } else if (arg == "--games") {
+      config.games = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--seed") {
+      config.seed = std::strtoull(value, nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1 && config.records && config.learningRate > 0;
+}
+
+template <class G> int run(const Config &config) {
+  std::optional<isola::RecordFile<G>> records =
+      isola::RecordFile<G>::open(config.records);
+  if (!records) {
+    std::fprintf(stderr, "%s is not a record file\n", config.records);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Sample<G>> training;
+  std::vector<Sample<G>> validation;
+  std::size_t games = config.games > 0
+                          ? std::min(config.games, records->size())
+                          : records->size();
+  for (std::size_t i = 0; i < games; ++i) {
+    const isola::BasicGameRecord<G> &record = (*records)[i];
+    std::vector<Sample<G>> &samples =
+        i % VALIDATION_STRIDE == 0 ? validation : training;
+    std::size_t before = samples.size();
+    int turn = 0;
+    bool valid = record
+                     .replay([&](const isola::BasicGameState<G> &state,
+                                 isola::Move) {
+                       if (turn++ >= config.skipPlies) {
+                         samples.push_back(
+                             {state, state.sideToMove() == record.winner
+                                         ? 1.0f
+                                         : 0.0f});
+                       }
+                     })
+                     .has_value();
+    if (!valid) {
+      std::fprintf(stderr, "%s: game %zu is corrupt, skipped\n",
+                   config.records, i);
+      samples.erase(samples.begin() + before, samples.end());
+    }
+  }
+  if (training.empty()) {
+    std::fprintf(stderr, "%s has no positions to train on\n",
+                 config.records);
+    return EXIT_FAILURE;
+  }
+  std::fprintf(stderr, "%zu games, %zu training and %zu validation positions\n",
+               games, training.size(), validation.size());
+
+  Clock::time_point start = Clock::now();
+  std::mt19937_64 random(config.seed);
+  Trainer<G> trainer(config);
+  for (int epoch = 1; epoch <= config.epochs; ++epoch) {
+    std::shuffle(training.begin(), training.end(), random);
+    double trainingLoss = 0;
+    for (std::size_t first = 0; first < training.size();
+         first += config.batch) {
+      std::size_t last = std::min(first + config.batch, training.size());
+      for (std::size_t i = first; i < last; ++i) {
+        trainingLoss += trainer.sample(training[i], true);
+      }
+      trainer.step(last - first);
+    }
+
+    double validationLoss = 0;
+    for (const Sample<G> &sample : validation) {
+      validationLoss += trainer.sample(sample, false);
+    }
+    std::fprintf(stderr,
+                 "epoch %3d  training loss %.4f  validation loss %.4f  "
+                 "%.1f s\n",
+                 epoch, trainingLoss / training.size(),
+                 validation.empty() ? 0.0 : validationLoss / validation.size(),
+                 std::chrono::duration<double>(Clock::now() - start).count());
+  }
+
+  auto weights = std::make_unique<isola::NetworkWeights<G>>();
+  trainer.quantize(*weights);
+  if (!isola::writeNetwork<G>(config.out, *weights)) {
+    std::perror(config.out);
+    return EXIT_FAILURE;
+  }
+  std::fprintf(stderr, "network written to %s\n", config.out);
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::fprintf(stderr,
+                 "Usage: %s --records <file> [--out <file>] [--epochs <n>]\n"
+                 "       [--batch <n>] [--lr <rate>] [--skip-plies <n>]\n"
+                 "       [--games <n>] [--seed <n>]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::optional<isola::BoardSize> size =
+      isola::recordBoardSize(config.records);
+  if (!size) {
+    std::fprintf(stderr, "%s is not a record file\n", config.records);
+    return EXIT_FAILURE;
+  }
+  int status = EXIT_FAILURE;
+  if (!isola::dispatchGeometry(*size,
+                               [&]<class G>() { status = run<G>(config); })) {
+    std::fprintf(stderr, "%dx%d boards are not supported\n", size->rows,
+                 size->cols);
+  }
+  return status;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+/*
+    clang-format off
+
+    Transposition table shared by the search threads.
+
+    The table is an array of cache-line sized buckets, each holding four
+    entries. An entry is two 64-bit words:
+        key  = hash ^ data
+        data = move | score | depth | bound | generation
+    Both words are written and read separately without any lock. When another
+    thread tears an entry by writing it at the same time, key ^ data no longer
+    gives back the position's hash and the probe simply misses, so a torn
+    entry can never be mistaken for a valid one.
+
+    clang-format on
+*/
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "eval.hpp"
+#include "game_state.hpp"
+
+namespace isola {
+
+enum class Bound : std::uint8_t { None = 0, Upper = 1, Lower = 2, Exact = 3 };
+
+struct TTData {
+  Move move = NULL_MOVE;
+  Score score = 0;
+  int depth = 0;
+  Bound bound = Bound::None;
+};
+
+// Win scores are stored relative to the node rather than the root, so an entry
+// stays correct when the position is reached at a different ply
+constexpr Score scoreToTT(Score score, int ply) {
+  if (score >= SCORE_WIN_BOUND) {
+    return score + ply;
+  } else if (score <= -SCORE_WIN_BOUND) {
+    return score - ply;
+  }
+  return score;
+}
+
+constexpr Score scoreFromTT(Score score, int ply) {
+  if (score >= SCORE_WIN_BOUND) {
+    return score - ply;
+  } else if (score <= -SCORE_WIN_BOUND) {
+    return score + ply;
+  }
+  return score;
+}
+
+class TranspositionTable {
+  struct Entry {
+    std::atomic<std::uint64_t> key;
+    std::atomic<std::uint64_t> data;
+  };
+
+  static constexpr std::size_t BUCKET_ENTRIES = 4;
+
+  struct alignas(64) Bucket {
+    Entry entries[BUCKET_ENTRIES];
+  };
+  static_assert(sizeof(Bucket) == 64);
+
+  static constexpr int GENERATION_BITS = 6;
+  static constexpr std::uint8_t GENERATION_MASK = (1 << GENERATION_BITS) - 1;
+
+  std::unique_ptr<Bucket[]> m_buckets;
+  std::size_t m_bucketCount = 0;
+  std::uint8_t m_generation = 0;
+
+public:
+  static constexpr std::size_t DEFAULT_SIZE_MB = 16;
+
+  explicit TranspositionTable(std::size_t megabytes = DEFAULT_SIZE_MB) {
+    resize(megabytes);
+  }
+
+  // Drops every entry, must not be called while a search uses the table
+  void resize(std::size_t megabytes) {
+    std::size_t count = megabytes * 1024 * 1024 / sizeof(Bucket);
+    m_bucketCount = count > 0 ? count : 1;
+    m_buckets.reset(new Bucket[m_bucketCount]());
+  }
+
+  std::size_t sizeMB() const {
+    return m_bucketCount * sizeof(Bucket) / (1024 * 1024);
+  }
+
+  void clear() {
+    for (std::size_t i = 0; i < m_bucketCount; ++i) {
+      for (Entry &entry : m_buckets[i].entries) {
+        entry.key.store(0, std::memory_order_relaxed);
+        entry.data.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Called once per search so entries from older searches get replaced first
+  void newSearch() { m_generation = (m_generation + 1) & GENERATION_MASK; }
+
+  bool probe(std::uint64_t hash, TTData &out) const {
+    const Bucket &bucket = bucketFor(hash);
+    for (const Entry &entry : bucket.entries) {
+      std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+      std::uint64_t key = entry.key.load(std::memory_order_relaxed);
+      if ((key ^ data) == hash && data != 0) {
+        out = unpack(data);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void store(std::uint64_t hash, Move move, Score score, int depth,
+             Bound bound) {
+    Bucket &bucket = bucketFor(hash);
+
+    // Overwrite the same position if present, else the least valuable entry
+    Entry *replace = &bucket.entries[0];
+    int worst = INT32_MAX;
+    for (Entry &entry : bucket.entries) {
+      std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+      std::uint64_t key = entry.key.load(std::memory_order_relaxed);
+      if ((key ^ data) == hash) {
+        // Keep the old move when this search didn't find one
+        if (move == NULL_MOVE) {
+          move = unpack(data).move;
+        }
+        replace = &entry;
+        break;
+      }
+
+      int value = data == 0 ? INT32_MIN : valueOf(data);
+      if (value < worst) {
+        worst = value;
+        replace = &entry;
+      }
+    }
+
+    std::uint64_t data = pack(move, score, depth, bound);
+    replace->key.store(hash ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+  }
+
+  // Permille of sampled entries written by the current search
+  int hashfull() const {
+    std::size_t samples = m_bucketCount < 250 ? m_bucketCount : 250;
+    std::size_t used = 0;
+    for (std::size_t i = 0; i < samples; ++i) {
+      for (const Entry &entry : m_buckets[i].entries) {
+        std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+        used += data != 0 && generationOf(data) == m_generation;
+      }
+    }
+    return samples > 0 ? used * 1000 / (samples * BUCKET_ENTRIES) : 0;
+  }
+
+private:
+  Bucket &bucketFor(std::uint64_t hash) const {
+    // Maps the hash onto [0, count) without needing a power of two size
+    std::size_t index = static_cast<std::size_t>(
+        (static_cast<unsigned __int128>(hash) * m_bucketCount) >> 64);
+    return m_buckets[index];
+  }
+
+  // Deeper and more recent entries are worth more
+  int valueOf(std::uint64_t data) const {
+    int age = (m_generation - generationOf(data)) & GENERATION_MASK;
+    return static_cast<int>((data >> 40) & 0xff) - 8 * age;
+  }
+
+  static std::uint8_t generationOf(std::uint64_t data) {
+    return (data >> 50) & GENERATION_MASK;
+  }
+
+  std::uint64_t pack(Move move, Score score, int depth, Bound bound) const {
+    assert(depth >= 0 && depth < 256);
+    assert(score >= INT16_MIN && score <= INT16_MAX);
+    return std::uint64_t{static_cast<std::uint8_t>(move.from)} |
+           std::uint64_t{static_cast<std::uint8_t>(move.to)} << 8 |
+           std::uint64_t{static_cast<std::uint8_t>(move.arrow)} << 16 |
+           std::uint64_t{static_cast<std::uint16_t>(score)} << 24 |
+           std::uint64_t{static_cast<std::uint8_t>(depth)} << 40 |
+           std::uint64_t{static_cast<std::uint8_t>(bound)} << 48 |
+           std::uint64_t{m_generation} << 50;
+  }
+
+  static TTData unpack(std::uint64_t data) {
+    return {.move = {.from = static_cast<std::int8_t>(data & 0xff),
+                     .to = static_cast<std::int8_t>((data >> 8) & 0xff),
+                     .arrow = static_cast<std::int8_t>((data >> 16) & 0xff)},
+            .score = static_cast<std::int16_t>((data >> 24) & 0xffff),
+            .depth = static_cast<int>((data >> 40) & 0xff),
+            .bound = static_cast<Bound>((data >> 48) & 0x3)};
+  }
+};
+
+} // namespace isola
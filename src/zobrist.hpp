@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+    Zobrist keys for hashing Isola positions.
+
+    A position hashes to the XOR of one key per dead square, one key per player
+    square and the side key when the second player is to move. Every change
+    made by a step or an arrow is one or two XORs, so GameState keeps its hash
+    up to date incrementally. The keys are generated at compile time from a
+    fixed seed, which keeps hashes identical between runs and builds.
+*/
+
+#include <array>
+#include <cstdint>
+
+#include "bitboard.hpp"
+
+namespace isola {
+
+template <class G> struct ZobristKeys {
+  std::array<std::uint64_t, G::SQUARES> dead;
+  std::array<std::array<std::uint64_t, G::SQUARES>, 2> player;
+  std::uint64_t side;
+};
+
+constexpr std::uint64_t splitMix64(std::uint64_t &state) {
+  std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+// Every geometry draws its keys from the same seed, hashes are only ever
+// compared between positions of the same size
+template <class G>
+constexpr ZobristKeys<G> ZOBRIST = [] {
+  ZobristKeys<G> keys{};
+  std::uint64_t state = 0x15014;
+  for (std::uint64_t &key : keys.dead) {
+    key = splitMix64(state);
+  }
+  for (auto &squares : keys.player) {
+    for (std::uint64_t &key : squares) {
+      key = splitMix64(state);
+    }
+  }
+  keys.side = splitMix64(state);
+  return keys;
+}();
+
+} // namespace isola